@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "arena.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace holefill {
+
+constexpr size_t chunkAlignment = 64;
+
+Arena::Arena(const size_t chunkSize, const bool hugePages)
+    : chunkSize(std::max<size_t>(chunkSize, chunkAlignment)), hugePages(hugePages) {}
+
+Arena::~Arena() {
+    release();
+}
+
+void Arena::reset() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    current = 0;
+    used = 0;
+}
+
+void Arena::release() {
+    const std::lock_guard<std::mutex> lock(mutex);
+    for (const Chunk& chunk : chunks) freeChunk(chunk);
+    chunks.clear();
+    current = 0;
+    used = 0;
+}
+
+size_t Arena::capacity() const {
+    const std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) total += chunk.size;
+    return total;
+}
+
+Arena::Chunk Arena::allocateChunk(const size_t bytes) const {
+#ifdef __linux__
+    if (hugePages && bytes >= hugePageSize) {
+        // Over-map by one huge page and trim, so the chunk starts on a huge page boundary
+        const size_t size = (bytes + hugePageSize - 1) / hugePageSize * hugePageSize;
+        void* const mapping = mmap(nullptr, size + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED) {
+            char* const start = static_cast<char*>(mapping);
+            char* const base = reinterpret_cast<char*>(
+                (reinterpret_cast<uintptr_t>(start) + hugePageSize - 1) / hugePageSize * hugePageSize);
+            if (base > start) munmap(start, static_cast<size_t>(base - start));
+            if (base + size < start + size + hugePageSize) {
+                munmap(base + size, static_cast<size_t>(start + size + hugePageSize - (base + size)));
+            }
+            madvise(base, size, MADV_HUGEPAGE);
+            return {base, size, true};
+        }
+    }
+#endif
+    return {static_cast<char*>(::operator new(bytes, std::align_val_t{chunkAlignment})), bytes, false};
+}
+
+void Arena::freeChunk(const Chunk& chunk) {
+#ifdef __linux__
+    if (chunk.mapped) {
+        munmap(chunk.base, chunk.size);
+        return;
+    }
+#endif
+    ::operator delete(chunk.base, std::align_val_t{chunkAlignment});
+}
+
+void* Arena::do_allocate(const size_t bytes, const size_t alignment) {
+    const std::lock_guard<std::mutex> lock(mutex);
+
+    for (;;) {
+        if (current < chunks.size()) {
+            const Chunk& chunk = chunks[current];
+            const uintptr_t address = reinterpret_cast<uintptr_t>(chunk.base) + used;
+            const size_t offset = used + static_cast<size_t>((alignment - address % alignment) % alignment);
+            if (offset <= chunk.size && bytes <= chunk.size - offset) {
+                used = offset + bytes;
+                return chunk.base + offset;
+            }
+
+            // Chunks kept from earlier calls are reused in order before new ones are added
+            ++current;
+            used = 0;
+            continue;
+        }
+
+        chunks.push_back(allocateChunk(std::max(chunkSize, bytes + alignment)));
+    }
+}
+
+void Arena::do_deallocate(void* const, const size_t, const size_t) {
+    // Memory is reclaimed by reset()
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+} // namespace holefill
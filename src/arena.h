@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+namespace holefill {
+
+/**
+ * @brief Bump allocator for the scratch memory of repeated fill calls.
+ *
+ * Pass an Arena as FillOptions::upstream and call reset() between fills. Memory handed out by the
+ * arena is never returned to the system until the arena is destroyed or release() is called, so
+ * after the first fill of a given size later fills neither call malloc nor fault in fresh pages.
+ *
+ * Memory is taken from the system in chunks. On Linux, chunks of at least hugePageSize bytes are
+ * mapped aligned to huge pages and advised with MADV_HUGEPAGE, so that large scratch arrays are
+ * backed by transparent huge pages where the kernel allows it.
+ *
+ * Deallocation is a no-op; memory is reclaimed by reset(). Allocation is serialized by a mutex,
+ * so one arena may serve the parallel engines, but it must not be reset while a fill is running.
+ */
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t hugePageSize = size_t(2) << 20;
+
+    /**
+     * @param chunkSize Minimum size of the chunks taken from the system. Larger requests get a chunk of their own.
+     * @param hugePages Whether chunks of at least hugePageSize bytes are advised to use huge pages.
+     */
+    explicit Arena(size_t chunkSize = hugePageSize, bool hugePages = true);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Makes all memory available again without returning it to the system. O(1).
+     */
+    void reset();
+
+    /**
+     * @brief Returns all chunks to the system.
+     */
+    void release();
+
+    /**
+     * @brief Total size of the chunks taken from the system, in bytes.
+     */
+    size_t capacity() const;
+
+private:
+    struct Chunk {
+        char* base;
+        size_t size;
+        bool mapped;   // Allocated with mmap rather than operator new
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    Chunk allocateChunk(size_t bytes) const;
+    static void freeChunk(const Chunk& chunk);
+
+    const size_t chunkSize;
+    const bool hugePages;
+
+    mutable std::mutex mutex;
+    std::vector<Chunk> chunks;
+    size_t current = 0;   // Chunk being allocated from
+    size_t used = 0;      // Bytes used in the current chunk
+};
+
+} // namespace holefill
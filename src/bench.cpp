@@ -0,0 +1,781 @@
+#include "holefill.h"
+#include "holefill_batch.h"
+#include "holefill_mask.h"
+#include "holefill_plan.h"
+#include "holefill_session.h"
+#include "arena.h"
+#include "color.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+float defaultWeightFunction(const holefill::Coord& u, const holefill::Coord& v) {
+    const float epsilon = 0.01f;
+    const float zeta = 3.0f;
+    const float dx = static_cast<float>(u.x - v.x);
+    const float dy = static_cast<float>(u.y - v.y);
+    const float distanceSquared = dx * dx + dy * dy;
+    return 1.0f / powf(distanceSquared + epsilon, zeta);
+}
+
+// Smooth synthetic image with a ring-shaped hole of the given thickness in the centre.
+// The boundary grows with the radius while the hole stays thin.
+std::vector<float> makeWorkload(const int32_t width, const int32_t height, const int32_t radius, const int32_t thickness) {
+    std::vector<float> image(static_cast<size_t>(width) * height);
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            const int32_t dx = x - width / 2;
+            const int32_t dy = y - height / 2;
+            const int32_t inner = std::max(0, radius - thickness);
+            const int32_t distanceSquared = dx * dx + dy * dy;
+            image[static_cast<size_t>(y) * width + x] = (distanceSquared <= radius * radius && distanceSquared >= inner * inner)
+                ? -1.0f
+                : 0.5f + 0.25f * std::sin(x * 0.05f) * std::cos(y * 0.03f);
+        }
+    }
+    return image;
+}
+
+size_t countBoundary(const std::vector<float>& image, const int32_t width, const int32_t height) {
+    size_t count = 0;
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            if (image[static_cast<size_t>(y) * width + x] < 0.0f) continue;
+            bool touchesHole = false;
+            for (int32_t dy = -1; dy <= 1 && !touchesHole; ++dy) {
+                for (int32_t dx = -1; dx <= 1 && !touchesHole; ++dx) {
+                    const int32_t nx = x + dx;
+                    const int32_t ny = y + dy;
+                    touchesHole = nx >= 0 && ny >= 0 && nx < width && ny < height &&
+                                  image[static_cast<size_t>(ny) * width + nx] < 0.0f;
+                }
+            }
+            count += touchesHole ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+// Best of several runs of fillFunc on fresh copies of the workload, in seconds
+template <typename FillFunc>
+double timeFill(const std::vector<float>& workload, const int repetitions, FillFunc fillFunc) {
+    double best = std::numeric_limits<double>::max();
+    for (int r = 0; r < repetitions; ++r) {
+        std::vector<float> image = workload;
+        const auto start = std::chrono::steady_clock::now();
+        fillFunc(image.data());
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+// Times the KD-tree and the brute-force paths of fillExactWithSearch over growing boundaries
+void benchSearchCrossover(const size_t k) {
+    constexpr int32_t size = 1024;
+    const holefill::Tuning saved = holefill::tuning();
+    size_t crossover = 0;
+
+    for (const int32_t radius : {8, 16, 32, 64, 128, 256, 400}) {
+        const std::vector<float> workload = makeWorkload(size, size, radius, 4);
+        const size_t boundary = countBoundary(workload, size, size);
+
+        holefill::tuning().bruteForceSearchMaxBoundary = 0;
+        const double tree = timeFill(workload, 3, [&](float* image) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, k);
+        });
+
+        holefill::tuning().bruteForceSearchMaxBoundary = std::numeric_limits<size_t>::max();
+        const double brute = timeFill(workload, 3, [&](float* image) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, k);
+        });
+
+        if (brute <= tree) crossover = boundary;
+
+        std::cout << "{\"benchmark\": \"search_crossover\", \"k\": " << k
+                  << ", \"boundary\": " << boundary
+                  << ", \"tree_s\": " << tree
+                  << ", \"brute_force_s\": " << brute << "}" << std::endl;
+    }
+
+    holefill::tuning() = saved;
+    std::cout << "{\"benchmark\": \"search_crossover_result\", \"k\": " << k
+              << ", \"brute_force_search_max_boundary\": " << crossover << "}" << std::endl;
+}
+
+// Times repeated fills with scratch memory from the global allocator and from an arena reset between calls
+void benchArena() {
+    constexpr int32_t size = 1024;
+    const std::vector<float> workload = makeWorkload(size, size, 300, 100);
+
+    const std::pair<const char*, void (*)(float*, const holefill::FillOptions&)> engines[] = {
+        {"approx", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillApproximate(image, size, size, options);
+        }},
+        {"search", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, 16, options);
+        }},
+        {"dualtree", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillExactWithDualTreeSearch(image, size, size, defaultWeightFunction, 16, options);
+        }},
+    };
+
+    for (const auto& [name, engine] : engines) {
+        const double global = timeFill(workload, 5, [&](float* image) { engine(image, {}); });
+
+        holefill::Arena arena;
+        holefill::FillOptions options;
+        options.upstream = &arena;
+        const double reused = timeFill(workload, 5, [&](float* image) {
+            arena.reset();
+            engine(image, options);
+        });
+
+        std::cout << "{\"benchmark\": \"arena\", \"engine\": \"" << name
+                  << "\", \"global_s\": " << global
+                  << ", \"arena_s\": " << reused
+                  << ", \"arena_bytes\": " << arena.capacity() << "}" << std::endl;
+    }
+}
+
+// Times the engines whose inner loops run in the dispatched kernels once per supported instruction set
+void benchIsa() {
+    constexpr int32_t size = 1024;
+    const std::vector<float> sparse = makeWorkload(size, size, 300, 2);
+    const std::vector<float> dense = makeWorkload(size, size, 300, 150);
+    const holefill::Isa saved = holefill::activeIsa();
+    const holefill::Tuning savedTuning = holefill::tuning();
+
+    for (const holefill::Isa isa : {holefill::Isa::Scalar, holefill::Isa::SSE42, holefill::Isa::AVX2, holefill::Isa::AVX512}) {
+        if (!holefill::selectIsa(isa)) continue;
+
+        holefill::tuning().bruteForceSearchMaxBoundary = std::numeric_limits<size_t>::max();
+        const double bruteForce = timeFill(sparse, 3, [&](float* image) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, 16);
+        });
+        holefill::tuning() = savedTuning;
+
+        const double tree = timeFill(dense, 3, [&](float* image) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, 16);
+        });
+        const double approx = timeFill(dense, 3, [&](float* image) {
+            holefill::fillApproximate(image, size, size);
+        });
+
+        std::cout << "{\"benchmark\": \"isa\", \"isa\": \"" << holefill::isaName(isa)
+                  << "\", \"search_brute_force_s\": " << bruteForce
+                  << ", \"search_tree_s\": " << tree
+                  << ", \"approx_s\": " << approx << "}" << std::endl;
+    }
+
+    holefill::selectIsa(saved);
+}
+
+// Times the engines with deterministic reductions against the fast path, whose results may depend on the thread count
+void benchDeterminism() {
+    constexpr int32_t exactSize = 512;
+    const std::vector<float> ring = makeWorkload(exactSize, exactSize, 200, 4);
+
+    const std::pair<const char*, void (*)(float*, const holefill::FillOptions&)> engines[] = {
+        {"exact", [](float* image, const holefill::FillOptions& options) {
+            holefill::fill(image, exactSize, exactSize, defaultWeightFunction, options);
+        }},
+        {"adaptive", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillAdaptive(image, exactSize, exactSize, defaultWeightFunction, 1.0e-3f, 32, options);
+        }},
+    };
+
+    for (const auto& [name, engine] : engines) {
+        holefill::FillOptions options;
+        options.deterministic = true;
+        const double deterministic = timeFill(ring, 3, [&](float* image) { engine(image, options); });
+        options.deterministic = false;
+        const double fast = timeFill(ring, 3, [&](float* image) { engine(image, options); });
+
+        std::cout << "{\"benchmark\": \"determinism\", \"engine\": \"" << name
+                  << "\", \"deterministic_s\": " << deterministic
+                  << ", \"fast_s\": " << fast
+                  << ", \"overhead\": " << (deterministic / fast - 1.0) << "}" << std::endl;
+    }
+}
+
+// Times the dual-tree search against the single-tree search, which give the same result, on discs and
+// rings of growing size. The single-tree search answers its queries on one thread, the dual tree
+// traverses subtrees of the hole tree in parallel.
+void benchDualTree() {
+    constexpr int32_t size = 1024;
+    const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (const int32_t radius : {100, 250, 450}) {
+        for (const int32_t thickness : {8, radius}) {
+            const std::vector<float> workload = makeWorkload(size, size, radius, thickness);
+            for (const size_t k : {4, 16, 100}) {
+                const double single = timeFill(workload, 3, [&](float* image) {
+                    holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, k);
+                });
+                const double dual = timeFill(workload, 3, [&](float* image) {
+                    holefill::fillExactWithDualTreeSearch(image, size, size, defaultWeightFunction, k);
+                });
+
+                std::cout << "{\"benchmark\": \"dualtree\", \"threads\": " << threads
+                          << ", \"radius\": " << radius << ", \"thickness\": " << thickness << ", \"k\": " << k
+                          << ", \"search_s\": " << single << ", \"dualtree_s\": " << dual
+                          << ", \"speedup\": " << (single / dual) << "}" << std::endl;
+            }
+        }
+    }
+}
+
+// Times many small fills and a few large ones run one after another against a single fillBatch call
+void benchBatch() {
+    constexpr int32_t smallSize = 64;
+    constexpr int32_t largeSize = 1024;
+    constexpr size_t smallCount = 2000;
+    std::vector<std::vector<float>> workloads;
+    for (size_t i = 0; i < smallCount; ++i) {
+        workloads.push_back(makeWorkload(smallSize, smallSize, 8 + static_cast<int32_t>(i % 20), 4));
+    }
+    for (const int32_t radius : {200, 300}) workloads.push_back(makeWorkload(largeSize, largeSize, radius, 50));
+
+    const auto makeJobs = [&](std::vector<std::vector<float>>& images) {
+        std::vector<holefill::FillJob> jobs(images.size());
+        for (size_t i = 0; i < images.size(); ++i) {
+            jobs[i].image = images[i].data();
+            jobs[i].width = jobs[i].height = (i < smallCount) ? smallSize : largeSize;
+            jobs[i].weightFunc = defaultWeightFunction;
+            jobs[i].nearestNeighborMax = 16;
+        }
+        return jobs;
+    };
+
+    double sequential = std::numeric_limits<double>::max();
+    double batch = std::numeric_limits<double>::max();
+    for (int r = 0; r < 3; ++r) {
+        std::vector<std::vector<float>> images = workloads;
+        std::vector<holefill::FillJob> jobs = makeJobs(images);
+        auto start = std::chrono::steady_clock::now();
+        for (const holefill::FillJob& job : jobs) {
+            holefill::fillExactWithSearch(job.image, job.width, job.height, job.weightFunc, job.nearestNeighborMax);
+        }
+        sequential = std::min(sequential, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        images = workloads;
+        jobs = makeJobs(images);
+        start = std::chrono::steady_clock::now();
+        holefill::fillBatch(jobs);
+        batch = std::min(batch, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::cout << "{\"benchmark\": \"batch\", \"jobs\": " << workloads.size()
+              << ", \"sequential_s\": " << sequential
+              << ", \"batch_s\": " << batch
+              << ", \"jobs_per_s\": " << (static_cast<double>(workloads.size()) / batch)
+              << ", \"speedup\": " << (sequential / batch) << "}" << std::endl;
+}
+
+// Times each phase of every engine and counts its hardware events where perf events are available
+void benchPhases() {
+    constexpr int32_t size = 1024;
+    const std::vector<float> workload = makeWorkload(size, size, 300, 40);
+    const std::vector<float> ring = makeWorkload(size / 2, size / 2, 200, 4);
+
+    const std::pair<const char*, void (*)(float*, const holefill::FillOptions&)> engines[] = {
+        {"exact", [](float* image, const holefill::FillOptions& options) {
+            holefill::fill(image, size / 2, size / 2, defaultWeightFunction, options);
+        }},
+        {"approx", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillApproximate(image, size, size, options);
+        }},
+        {"search", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, 16, options);
+        }},
+        {"adaptive", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillAdaptive(image, size / 2, size / 2, defaultWeightFunction, 1.0e-3f, 32, options);
+        }},
+        {"stochastic", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillStochastic(image, size, size, defaultWeightFunction, 64, nullptr, 0, options);
+        }},
+        {"dualtree", [](float* image, const holefill::FillOptions& options) {
+            holefill::fillExactWithDualTreeSearch(image, size, size, defaultWeightFunction, 16, options);
+        }},
+    };
+
+    for (const auto& [name, engine] : engines) {
+        const std::string engineName = name;
+        std::vector<float> image = (engineName == "exact" || engineName == "adaptive") ? ring : workload;
+
+        holefill::FillStats stats;
+        holefill::FillOptions options;
+        options.stats = &stats;
+        options.countEvents = true;
+        engine(image.data(), options);
+
+        for (size_t p = 0; p < holefill::fillPhaseCount; ++p) {
+            const holefill::PhaseStats& phase = stats.phases[p];
+            // Counts are null rather than zero when they could not be taken
+            const auto count = [&](const uint64_t value) {
+                return stats.eventsCounted ? std::to_string(value) : std::string("null");
+            };
+
+            std::cout << "{\"benchmark\": \"phases\", \"engine\": \"" << name
+                      << "\", \"phase\": \"" << holefill::phaseName(static_cast<holefill::FillPhase>(p))
+                      << "\", \"seconds\": " << phase.seconds
+                      << ", \"cycles\": " << count(phase.cycles)
+                      << ", \"instructions\": " << count(phase.instructions)
+                      << ", \"l1d_misses\": " << count(phase.l1dMisses)
+                      << ", \"llc_misses\": " << count(phase.llcMisses)
+                      << ", \"branch_misses\": " << count(phase.branchMisses) << "}" << std::endl;
+        }
+    }
+}
+
+// Times the packed mask steps on a noisy 4K mask against the same steps on a byte per pixel
+void benchMask() {
+    constexpr int32_t width = 3840;
+    constexpr int32_t height = 2160;
+    constexpr int32_t radius = 4;
+    constexpr size_t minArea = 16;
+    const size_t pixels = static_cast<size_t>(width) * height;
+
+    // Ellipses of holes, with speckles sprinkled over the whole mask
+    std::vector<uint8_t> maskPixels(pixels);
+    uint32_t state = 1;
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            state = state * 1664525u + 1013904223u;
+            const float u = (x % 640 - 320) / 200.0f;
+            const float v = (y % 540 - 270) / 120.0f;
+            const bool hole = u * u + v * v <= 1.0f || (state >> 24) < 3;
+            maskPixels[static_cast<size_t>(y) * width + x] = hole ? 0 : 255;
+        }
+    }
+    std::vector<float> image(pixels, 0.5f);
+
+    const auto timeBest = [](const auto& steps) {
+        double best = std::numeric_limits<double>::max();
+        for (int r = 0; r < 3; ++r) {
+            const auto start = std::chrono::steady_clock::now();
+            steps();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    };
+
+    size_t packedHoles = 0;
+    const double packed = timeBest([&] {
+        holefill::HoleMask mask = holefill::HoleMask::threshold(maskPixels.data(), width, height, 128);
+        mask.removeComponentsSmallerThan(minArea);
+        mask.dilate(radius);
+        mask.applyTo(image.data());
+        packedHoles = mask.count();
+    });
+
+    // Speckle removal is left out of the byte steps, which makes them only faster
+    const double bytes = timeBest([&] {
+        std::vector<uint8_t> holes(pixels);
+        std::vector<uint8_t> rows(pixels);
+        for (size_t i = 0; i < pixels; ++i) holes[i] = maskPixels[i] < 128;
+        for (int32_t y = 0; y < height; ++y) {
+            for (int32_t x = 0; x < width; ++x) {
+                uint8_t any = 0;
+                for (int32_t dx = std::max(0, x - radius); dx <= std::min(width - 1, x + radius); ++dx) {
+                    any |= holes[static_cast<size_t>(y) * width + dx];
+                }
+                rows[static_cast<size_t>(y) * width + x] = any;
+            }
+        }
+        for (int32_t y = 0; y < height; ++y) {
+            for (int32_t x = 0; x < width; ++x) {
+                uint8_t any = 0;
+                for (int32_t dy = std::max(0, y - radius); dy <= std::min(height - 1, y + radius); ++dy) {
+                    any |= rows[static_cast<size_t>(dy) * width + x];
+                }
+                if (any) image[static_cast<size_t>(y) * width + x] = -1.0f;
+            }
+        }
+    });
+
+    std::cout << "{\"benchmark\": \"mask\", \"pixels\": " << pixels
+              << ", \"holes\": " << packedHoles
+              << ", \"packed_s\": " << packed
+              << ", \"bytes_s\": " << bytes
+              << ", \"speedup\": " << (bytes / packed) << "}" << std::endl;
+}
+
+// Compares the plans planFill makes with the cost model of tuning() with their actual time and with
+// their actual largest difference from fill(). holefill_tune fits the cost model to this machine.
+void benchPlan() {
+    constexpr int32_t size = 512;
+    const std::pair<const char*, std::vector<float>> workloads[] = {
+        {"thin_ring", makeWorkload(size, size, 200, 4)},
+        {"thick_ring", makeWorkload(size, size, 200, 60)},
+        {"disc", makeWorkload(size, size, 120, 120)},
+    };
+    for (const auto& [name, workload] : workloads) {
+        std::vector<float> reference = workload;
+        holefill::fill(reference.data(), size, size, defaultWeightFunction);
+
+        for (const float tolerance : {1.0e-1f, 1.0e-2f, 1.0e-4f}) {
+            std::vector<float> image = workload;
+            holefill::FillTarget target;
+            target.tolerance = tolerance;
+            const holefill::FillPlan plan = holefill::fillAuto(image.data(), size, size, defaultWeightFunction, target);
+
+            float error = 0.0f;
+            for (size_t i = 0; i < image.size(); ++i) error = std::max(error, std::abs(image[i] - reference[i]));
+
+            std::cout << "{\"benchmark\": \"plan\", \"workload\": \"" << name
+                      << "\", \"tolerance\": " << tolerance
+                      << ", \"method\": \"" << holefill::fillMethodName(plan.method) << "\""
+                      << ", \"k\": " << plan.nearestNeighborMax
+                      << ", \"samples\": " << plan.samplesPerPixel
+                      << ", \"plan_s\": " << plan.planSeconds
+                      << ", \"predicted_s\": " << plan.predictedSeconds
+                      << ", \"actual_s\": " << plan.actualSeconds
+                      << ", \"predicted_error\": " << plan.predictedError
+                      << ", \"actual_error\": " << error << "}" << std::endl;
+        }
+    }
+}
+
+// Fills one 8-bit RGB image with 32 masks of a few small holes each: converting the image for every
+// mask as single fills do, against a session that converts it once and fills the masks in one call
+void benchSession() {
+    constexpr int32_t size = 2048;
+    constexpr size_t maskCount = 32;
+    std::vector<unsigned char> rgb(static_cast<size_t>(size) * size * 3);
+    for (size_t i = 0; i < rgb.size(); ++i) rgb[i] = static_cast<unsigned char>((i * 2654435761u) >> 24);
+
+    std::vector<holefill::HoleMask> masks;
+    for (size_t m = 0; m < maskCount; ++m) {
+        holefill::HoleMask mask(size, size);
+        for (int32_t hole = 0; hole < 4; ++hole) {
+            const int32_t cx = static_cast<int32_t>((m * 7919 + hole * 104729) % (size - 64)) + 32;
+            const int32_t cy = static_cast<int32_t>((m * 6271 + hole * 15485863) % (size - 64)) + 32;
+            for (int32_t y = cy - 24; y <= cy + 24; ++y) {
+                for (int32_t x = cx - 24; x <= cx + 24; ++x) {
+                    if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= 24 * 24) mask.row(y)[x >> 6] |= uint64_t{1} << (x & 63);
+                }
+            }
+        }
+        masks.push_back(std::move(mask));
+    }
+
+    const auto toLinear = [&] {
+        std::vector<float> image(static_cast<size_t>(size) * size);
+        for (size_t i = 0; i < image.size(); ++i) image[i] = rgbToGrayscaleLinear(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+        return image;
+    };
+
+    std::vector<std::vector<float>> outputs(maskCount, std::vector<float>(static_cast<size_t>(size) * size));
+    for (const holefill::FillMethod method : {holefill::FillMethod::Approximate, holefill::FillMethod::Search}) {
+        holefill::FillJob parameters;
+        parameters.method = method;
+        parameters.weightFunc = defaultWeightFunction;
+        parameters.nearestNeighborMax = 16;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t m = 0; m < maskCount; ++m) {
+            outputs[m] = toLinear();
+            masks[m].applyTo(outputs[m].data());
+            holefill::FillJob job = parameters;
+            job.image = outputs[m].data();
+            job.width = job.height = size;
+            holefill::runFillJob(job);
+        }
+        const auto middle = std::chrono::steady_clock::now();
+
+        const holefill::FillSession session(toLinear().data(), size, size);
+        std::vector<holefill::SessionMask> fills(maskCount);
+        for (size_t m = 0; m < maskCount; ++m) fills[m] = {&masks[m], outputs[m].data()};
+        session.fill(fills, parameters);
+        const auto end = std::chrono::steady_clock::now();
+
+        const double separate = std::chrono::duration<double>(middle - start).count();
+        const double sessionSeconds = std::chrono::duration<double>(end - middle).count();
+        std::cout << "{\"benchmark\": \"session\", \"method\": \"" << holefill::fillMethodName(method)
+                  << "\", \"masks\": " << maskCount
+                  << ", \"separate_s\": " << separate
+                  << ", \"session_s\": " << sessionSeconds
+                  << ", \"speedup\": " << (separate / sessionSeconds) << "}" << std::endl;
+    }
+}
+
+// Times one fill per setting against one sweep over all settings, for three exponents of the
+// distance with fill and three neighbor counts with fillExactWithSearch
+void benchSweep() {
+    const auto weightFunction = [](const float zeta) {
+        return [zeta](const holefill::Coord& u, const holefill::Coord& v) {
+            const float dx = static_cast<float>(u.x - v.x);
+            const float dy = static_cast<float>(u.y - v.y);
+            return 1.0f / powf(dx * dx + dy * dy + 0.01f, zeta);
+        };
+    };
+    const float zetas[] = {2.0f, 3.0f, 4.0f};
+    const size_t ks[] = {4, 16, 64};
+
+    // With kernels the settings share the distance of each pair, the separate fills call the kernel as weight function
+    const auto run = [&](const char* const engine, const bool kernels, const int32_t size, const std::vector<float>& workload,
+                         const auto& fillOne, const auto& fillAll) {
+        std::vector<std::vector<float>> outputs(3, std::vector<float>(workload.size()));
+        std::vector<holefill::SweepSetting> settings;
+        for (size_t i = 0; i < 3; ++i) {
+            if (kernels) {
+                const holefill::PowerKernel kernel{0.01f, zetas[i]};
+                settings.push_back({kernel, ks[i], outputs[i].data(), kernel});
+            } else {
+                settings.push_back({weightFunction(zetas[i]), ks[i], outputs[i].data()});
+            }
+        }
+
+        const double separate = timeFill(workload, 3, [&](float* image) {
+            for (size_t i = 0; i < 3; ++i) {
+                std::copy(image, image + workload.size(), outputs[i].begin());
+                fillOne(outputs[i].data(), settings[i]);
+            }
+        });
+        const double sweep = timeFill(workload, 3, [&](float* image) { fillAll(image, settings); });
+
+        std::cout << "{\"benchmark\": \"sweep\", \"engine\": \"" << engine
+                  << "\", \"size\": " << size
+                  << ", \"settings\": " << settings.size()
+                  << ", \"separate_s\": " << separate
+                  << ", \"sweep_s\": " << sweep
+                  << ", \"speedup\": " << (separate / sweep) << "}" << std::endl;
+    };
+
+    constexpr int32_t small = 256;
+    constexpr int32_t large = 1024;
+    for (const bool kernels : {false, true}) {
+        run(kernels ? "exact_kernel" : "exact", kernels, small, makeWorkload(small, small, 100, 4),
+            [&](float* image, const holefill::SweepSetting& setting) {
+                holefill::fill(image, small, small, setting.weightFunc);
+            },
+            [&](const float* image, const std::vector<holefill::SweepSetting>& settings) {
+                holefill::fillSweep(image, small, small, settings);
+            });
+
+        run(kernels ? "search_kernel" : "search", kernels, large, makeWorkload(large, large, 300, 40),
+            [&](float* image, const holefill::SweepSetting& setting) {
+                holefill::fillExactWithSearch(image, large, large, setting.weightFunc, setting.nearestNeighborMax);
+            },
+            [&](const float* image, const std::vector<holefill::SweepSetting>& settings) {
+                holefill::fillExactWithSearchSweep(image, large, large, settings);
+            });
+    }
+}
+
+// Times fillApproximate in the image's row-major layout and in a tiled copy of the box around the
+// holes, on images of growing width with a ring of holes across their full width
+void benchLayout() {
+    const holefill::Tuning saved = holefill::tuning();
+    constexpr int32_t height = 2048;
+
+    for (const int32_t width : {2048, 4096, 8192, 16384}) {
+        const std::vector<float> workload = makeWorkload(width, height, 1000, 1000);
+        const auto fillFunc = [&](float* image) { holefill::fillApproximate(image, width, height); };
+
+        holefill::tuning().blockedLayoutMinWidth = std::numeric_limits<int32_t>::max();
+        const double rowMajor = timeFill(workload, 3, fillFunc);
+        holefill::tuning().blockedLayoutMinWidth = 0;
+        const double blocked = timeFill(workload, 3, fillFunc);
+
+        std::cout << "{\"benchmark\": \"layout\", \"width\": " << width
+                  << ", \"height\": " << height
+                  << ", \"row_major_s\": " << rowMajor
+                  << ", \"blocked_s\": " << blocked
+                  << ", \"speedup\": " << (rowMajor / blocked) << "}" << std::endl;
+    }
+
+    holefill::tuning() = saved;
+}
+
+// Times fillMultiresolution against fill() on discs of growing radius and reports its error against
+// the full-resolution exact result, over all hole pixels and at the worst one. The default kernel
+// decays so fast that fill() falls back to zero a few dozen pixels into a hole, so a zeta of 1 is used.
+void benchMultiresolution() {
+    constexpr int32_t size = 512;
+    const auto weightFunction = [](const holefill::Coord& u, const holefill::Coord& v) {
+        const float dx = static_cast<float>(u.x - v.x);
+        const float dy = static_cast<float>(u.y - v.y);
+        return 1.0f / (dx * dx + dy * dy + 0.01f);
+    };
+    for (const int32_t radius : {60, 120, 200}) {
+        const std::vector<float> workload = makeWorkload(size, size, radius, radius);
+        std::vector<float> reference = workload;
+        const double exact = timeFill(workload, 1, [&](float* image) {
+            holefill::fill(image, size, size, weightFunction);
+            std::copy(image, image + workload.size(), reference.begin());
+        });
+
+        for (const int32_t factor : {2, 4}) {
+            std::vector<float> image = workload;
+            const double multiresolution = timeFill(workload, 1, [&](float* filled) {
+                holefill::fillMultiresolution(filled, size, size, weightFunction, factor);
+                std::copy(filled, filled + workload.size(), image.begin());
+            });
+
+            double sumSquares = 0.0;
+            float maxError = 0.0f;
+            size_t holeCount = 0;
+            for (size_t i = 0; i < image.size(); ++i) {
+                if (workload[i] >= 0.0f) continue;
+                const float error = std::abs(image[i] - reference[i]);
+                sumSquares += static_cast<double>(error) * error;
+                maxError = std::max(maxError, error);
+                ++holeCount;
+            }
+
+            std::cout << "{\"benchmark\": \"multires\", \"radius\": " << radius
+                      << ", \"factor\": " << factor
+                      << ", \"exact_s\": " << exact
+                      << ", \"multires_s\": " << multiresolution
+                      << ", \"speedup\": " << (exact / multiresolution)
+                      << ", \"rms_error\": " << std::sqrt(sumSquares / static_cast<double>(holeCount))
+                      << ", \"max_error\": " << maxError << "}" << std::endl;
+        }
+    }
+}
+
+// Times fillHybrid against fill() and fillApproximate on a few workloads and reports the error of
+// both cheaper fills against fill(), whether the hybrid met its tolerance and the share of the hole
+// pixels it filled exactly. The disc and the thick ring are deep enough to interpolate most of.
+void benchHybrid() {
+    constexpr int32_t size = 512;
+
+    // Scattered blobs of up to 10 pixels radius, as left by retouching a photo
+    std::vector<float> blobs = makeWorkload(size, size, 0, 0);
+    for (int32_t blob = 0; blob < 64; ++blob) {
+        const int32_t radius = 3 + blob % 8;
+        const int32_t cx = (blob * 7919) % (size - 32) + 16;
+        const int32_t cy = (blob * 6271) % (size - 32) + 16;
+        for (int32_t y = cy - radius; y <= cy + radius; ++y) {
+            for (int32_t x = cx - radius; x <= cx + radius; ++x) {
+                if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius) blobs[static_cast<size_t>(y) * size + x] = -1.0f;
+            }
+        }
+    }
+
+    const std::pair<const char*, std::vector<float>> workloads[] = {
+        {"blobs", blobs},
+        {"thin_ring", makeWorkload(size, size, 200, 4)},
+        {"thick_ring", makeWorkload(size, size, 200, 60)},
+        {"disc", makeWorkload(size, size, 120, 120)},
+    };
+    // Largest difference from reference over the hole pixels of workload
+    const auto maxError = [](const std::vector<float>& workload, const std::vector<float>& image,
+                             const std::vector<float>& reference) {
+        float error = 0.0f;
+        for (size_t i = 0; i < image.size(); ++i) {
+            if (workload[i] < 0.0f) error = std::max(error, std::abs(image[i] - reference[i]));
+        }
+        return error;
+    };
+
+    for (const auto& [name, workload] : workloads) {
+        std::vector<float> reference = workload;
+        const double exact = timeFill(workload, 1, [&](float* image) {
+            holefill::fill(image, size, size, defaultWeightFunction);
+            std::copy(image, image + workload.size(), reference.begin());
+        });
+
+        std::vector<float> approximate = workload;
+        const double approx = timeFill(workload, 3, [&](float* image) {
+            holefill::fillApproximate(image, size, size);
+            std::copy(image, image + workload.size(), approximate.begin());
+        });
+
+        for (const float tolerance : {1.0e-1f, 1.0e-2f, 1.0e-3f}) {
+            std::vector<float> hybrid = workload;
+            holefill::HybridFillReport report;
+            const double seconds = timeFill(workload, 1, [&](float* image) {
+                report = holefill::fillHybrid(image, size, size, defaultWeightFunction, tolerance);
+                std::copy(image, image + workload.size(), hybrid.begin());
+            });
+
+            const float hybridError = maxError(workload, hybrid, reference);
+            std::cout << "{\"benchmark\": \"hybrid\", \"workload\": \"" << name
+                      << "\", \"tolerance\": " << tolerance
+                      << ", \"exact_s\": " << exact
+                      << ", \"approx_s\": " << approx
+                      << ", \"hybrid_s\": " << seconds
+                      << ", \"refined_fraction\": " << report.refinedFraction()
+                      << ", \"approx_error\": " << maxError(workload, approximate, reference)
+                      << ", \"hybrid_error\": " << hybridError
+                      << ", \"within_tolerance\": " << (hybridError <= tolerance ? "true" : "false") << "}" << std::endl;
+        }
+    }
+}
+
+} // namespace
+
+int main(const int argc, const char** const argv) {
+    const std::string only = (argc > 1) ? argv[1] : "";
+
+    if (only.empty() || only == "crossover") {
+        benchSearchCrossover(16);
+        benchSearchCrossover(100);
+    }
+
+    if (only.empty() || only == "arena") {
+        benchArena();
+    }
+
+    if (only.empty() || only == "isa") {
+        benchIsa();
+    }
+
+    if (only.empty() || only == "determinism") {
+        benchDeterminism();
+    }
+
+    if (only.empty() || only == "dualtree") {
+        benchDualTree();
+    }
+
+    if (only.empty() || only == "batch") {
+        benchBatch();
+    }
+
+    if (only.empty() || only == "phases") {
+        benchPhases();
+    }
+
+    if (only.empty() || only == "mask") {
+        benchMask();
+    }
+
+    if (only.empty() || only == "session") {
+        benchSession();
+    }
+
+    if (only.empty() || only == "sweep") {
+        benchSweep();
+    }
+
+    if (only.empty() || only == "layout") {
+        benchLayout();
+    }
+
+    if (only.empty() || only == "multires") {
+        benchMultiresolution();
+    }
+
+    if (only.empty() || only == "hybrid") {
+        benchHybrid();
+    }
+
+    if (only.empty() || only == "plan") {
+        benchPlan();
+    }
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+// sRGB encoding of the 8-bit images and frames read and written by the CLI. The engines work on linear values.
+
+inline float srgbToLinear(const float c) {
+    if (c <= 0.04045f)
+        return c / 12.92f;
+    else
+        return powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(const float c) {
+    if (c <= 0.0031308f)
+        return c * 12.92f;
+    else
+        return 1.055f * powf(c, 1.0f/2.4f) - 0.055f;
+}
+
+// Linear value to 8-bit sRGB. Negative values, i.e. holes left unfilled, become black.
+inline unsigned char linearToSrgb8(const float linearValue) {
+    const float srgbValue = linearToSrgb(linearValue < 0.0f ? 0.0f : linearValue);
+    const float clamped = std::min(1.0f, std::max(0.0f, srgbValue));
+    return static_cast<unsigned char>(clamped * 255.0f);
+}
+
+// 8-bit sRGB to linear, tabulated since there are only 256 inputs
+inline const std::array<float, 256>& srgbToLinearTable() {
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> values;
+        for (size_t i = 0; i < values.size(); ++i) values[i] = srgbToLinear(i / 255.0f);
+        return values;
+    }();
+    return table;
+}
+
+// Convert sRGB to grayscale float in [0,1]
+inline float rgbToGrayscaleLinear(const unsigned char r, const unsigned char g, const unsigned char b) {
+    const std::array<float, 256>& table = srgbToLinearTable();
+    const float rf = table[r];
+    const float gf = table[g];
+    const float bf = table[b];
+    return 0.299f * rf + 0.587f * gf + 0.114f * bf;
+}
@@ -0,0 +1,339 @@
+#include "coordinator.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+namespace {
+
+struct ManifestJob {
+    size_t line;
+    FillJobSpec spec;
+    double cost = 0.0;
+    int attempts = 0;
+    // Times a worker died before it received the job, which do not count as attempts
+    int sendFailures = 0;
+    bool claimed = false;
+};
+
+// Retries after a worker crash before a job is reported as failed
+constexpr int maxAttempts = 2;
+
+// Workers dying before they receive a job point at a broken executable rather than the job, but
+// must not requeue it forever either
+constexpr int maxSendFailures = 4;
+
+bool readManifest(const std::string& manifestPath, std::vector<ManifestJob>& jobs) {
+    std::ifstream manifest(manifestPath);
+    if (!manifest) return false;
+
+    std::string text;
+    for (size_t line = 1; std::getline(manifest, text); ++line) {
+        std::istringstream fields(text);
+        ManifestJob job{line, {}};
+        if (!(fields >> job.spec.imagePath) || job.spec.imagePath[0] == '#') continue;
+
+        if (!(fields >> job.spec.maskPath >> job.spec.outputPath >> job.spec.method)) {
+            std::cerr << manifestPath << ":" << line << ": expected <image> <mask> <output> <fill_method>\n";
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+double secondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#ifndef _WIN32
+
+struct Worker {
+    pid_t pid = -1;
+    int input = -1;    // Worker's stdin
+    int output = -1;   // Worker's stdout
+    std::string buffer;
+    long job = -1;     // Index of the running job, -1 when idle
+    std::chrono::steady_clock::time_point start;
+};
+
+bool startWorker(Worker& worker, const char* const executable) {
+    int toWorker[2];
+    int fromWorker[2];
+    if (pipe(toWorker) != 0) return false;
+    if (pipe(fromWorker) != 0) {
+        close(toWorker[0]);
+        close(toWorker[1]);
+        return false;
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        close(toWorker[0]);
+        close(toWorker[1]);
+        close(fromWorker[0]);
+        close(fromWorker[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        dup2(toWorker[0], STDIN_FILENO);
+        dup2(fromWorker[1], STDOUT_FILENO);
+        close(toWorker[0]);
+        close(toWorker[1]);
+        close(fromWorker[0]);
+        close(fromWorker[1]);
+        execlp(executable, executable, "--worker", static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    close(toWorker[0]);
+    close(fromWorker[1]);
+
+    // Keep later workers from inheriting the pipes of this one
+    fcntl(toWorker[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fromWorker[0], F_SETFD, FD_CLOEXEC);
+
+    worker.pid = pid;
+    worker.input = toWorker[1];
+    worker.output = fromWorker[0];
+    worker.buffer.clear();
+    worker.job = -1;
+    return true;
+}
+
+void stopWorker(Worker& worker) {
+    if (worker.input >= 0) close(worker.input);
+    if (worker.output >= 0) close(worker.output);
+    if (worker.pid > 0) waitpid(worker.pid, nullptr, 0);
+    worker.pid = -1;
+    worker.input = -1;
+    worker.output = -1;
+}
+
+bool sendJob(const Worker& worker, const size_t index, const FillJobSpec& spec) {
+    const std::string line = std::to_string(index) + "\t" + spec.imagePath + "\t" + spec.maskPath + "\t" +
+                             spec.outputPath + "\t" + spec.method + "\n";
+    size_t written = 0;
+    while (written < line.size()) {
+        const ssize_t n = write(worker.input, line.data() + written, line.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Atomically claims a job in a directory shared between coordinators
+bool claimJob(const std::string& claimDir, const size_t line) {
+    const std::string path = claimDir + "/job-" + std::to_string(line) + ".claim";
+    const int fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+    if (fd < 0) return false;
+
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    const std::string owner = std::string(host) + " " + std::to_string(getpid()) + "\n";
+    const ssize_t ignored = write(fd, owner.data(), owner.size());
+    (void)ignored;
+    close(fd);
+    return true;
+}
+
+#endif
+
+} // namespace
+
+int runWorker(const RunJobFunction& runJob) {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream fields(line);
+        std::string id;
+        FillJobSpec spec;
+        std::getline(fields, id, '\t');
+        std::getline(fields, spec.imagePath, '\t');
+        std::getline(fields, spec.maskPath, '\t');
+        std::getline(fields, spec.outputPath, '\t');
+        std::getline(fields, spec.method, '\t');
+
+        const auto start = std::chrono::steady_clock::now();
+        const int status = runJob(spec);
+        std::cout << id << "\t" << status << "\t" << secondsSince(start) << std::endl;
+    }
+    return 0;
+}
+
+int runCoordinator(const char* const executable, const std::string& manifestPath, const size_t workerCount,
+                   const std::string& claimDir, const EstimateCostFunction& estimateCost) {
+#ifdef _WIN32
+    (void)executable;
+    (void)manifestPath;
+    (void)workerCount;
+    (void)claimDir;
+    (void)estimateCost;
+    std::cerr << "Coordinator mode is not supported on Windows.\n";
+    return 1;
+#else
+    std::vector<ManifestJob> jobs;
+    if (!readManifest(manifestPath, jobs)) {
+        std::cerr << "Failed to read manifest: " << manifestPath << "\n";
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Longest jobs first, so that the last jobs to finish are short ones
+    for (ManifestJob& job : jobs) job.cost = estimateCost(job.spec);
+    std::deque<size_t> pending;
+    for (size_t i = 0; i < jobs.size(); ++i) pending.push_back(i);
+    std::stable_sort(pending.begin(), pending.end(), [&](const size_t a, const size_t b) { return jobs[a].cost > jobs[b].cost; });
+
+    // A dead worker must not take the coordinator down with SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Worker> workers(std::min(workerCount, std::max<size_t>(jobs.size(), 1)));
+    for (Worker& worker : workers) {
+        if (!startWorker(worker, executable)) {
+            std::cerr << "Failed to start worker process.\n";
+            for (Worker& started : workers) stopWorker(started);
+            return 1;
+        }
+    }
+
+    size_t succeeded = 0;
+    size_t failed = 0;
+    size_t skipped = 0;
+
+    const auto finishJob = [&](const size_t index, const int status, const double seconds, const size_t workerIndex) {
+        const ManifestJob& job = jobs[index];
+        if (status == 0) ++succeeded; else ++failed;
+        std::cout << "job " << job.line << " " << job.spec.outputPath << " " << (status == 0 ? "ok" : "failed")
+                  << " " << seconds << "s worker " << workerIndex << std::endl;
+    };
+
+    // Requeues the job of a dead worker and starts a replacement. A job the worker never received
+    // did not run, so it is charged a send failure instead of an attempt.
+    const auto recoverWorker = [&](Worker& worker, const size_t workerIndex, const bool received) {
+        const long index = worker.job;
+        worker.job = -1;
+        stopWorker(worker);
+
+        if (index >= 0) {
+            ManifestJob& job = jobs[static_cast<size_t>(index)];
+            if (received ? ++job.attempts < maxAttempts : ++job.sendFailures < maxSendFailures) {
+                std::cerr << "Worker " << workerIndex << " died, retrying job " << job.line << "\n";
+                pending.push_front(static_cast<size_t>(index));
+            } else {
+                finishJob(static_cast<size_t>(index), -1, secondsSince(worker.start), workerIndex);
+            }
+        }
+
+        if (!startWorker(worker, executable)) {
+            std::cerr << "Failed to restart worker process " << workerIndex << ".\n";
+        }
+    };
+
+    for (;;) {
+        // Hand out jobs to idle workers
+        for (size_t w = 0; w < workers.size(); ++w) {
+            Worker& worker = workers[w];
+            if (worker.pid < 0 || worker.job >= 0) continue;
+
+            while (!pending.empty()) {
+                const size_t index = pending.front();
+                pending.pop_front();
+
+                if (!claimDir.empty() && !jobs[index].claimed) {
+                    if (!claimJob(claimDir, jobs[index].line)) {
+                        ++skipped;
+                        continue;
+                    }
+                    jobs[index].claimed = true;
+                }
+
+                worker.job = static_cast<long>(index);
+                worker.start = std::chrono::steady_clock::now();
+                if (!sendJob(worker, index, jobs[index].spec)) {
+                    // The job is back in pending, or failed for good: hand the restarted worker the next one,
+                    // as no busy worker may be left to wake the loop up for it
+                    recoverWorker(worker, w, false);
+                    if (worker.pid >= 0) continue;
+                }
+                break;
+            }
+        }
+
+        std::vector<pollfd> polled;
+        std::vector<size_t> polledWorkers;
+        for (size_t w = 0; w < workers.size(); ++w) {
+            if (workers[w].pid >= 0 && workers[w].job >= 0) {
+                polled.push_back({workers[w].output, POLLIN, 0});
+                polledWorkers.push_back(w);
+            }
+        }
+        if (polled.empty()) break;
+
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "poll failed\n";
+            break;
+        }
+
+        for (size_t p = 0; p < polled.size(); ++p) {
+            if (polled[p].revents == 0) continue;
+
+            Worker& worker = workers[polledWorkers[p]];
+            char chunk[4096];
+            const ssize_t n = read(worker.output, chunk, sizeof(chunk));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                recoverWorker(worker, polledWorkers[p], true);
+                continue;
+            }
+            worker.buffer.append(chunk, static_cast<size_t>(n));
+
+            // Result lines are '<job>\t<status>\t<seconds>'
+            for (size_t end; (end = worker.buffer.find('\n')) != std::string::npos;) {
+                std::istringstream fields(worker.buffer.substr(0, end));
+                worker.buffer.erase(0, end + 1);
+
+                size_t index = 0;
+                int status = 1;
+                double seconds = 0.0;
+                if (fields >> index >> status >> seconds && static_cast<long>(index) == worker.job) {
+                    finishJob(index, status, seconds, polledWorkers[p]);
+                    worker.job = -1;
+                }
+            }
+        }
+    }
+
+    // Jobs left over when no worker could be restarted or polling failed are reported as failed
+    for (Worker& worker : workers) {
+        if (worker.job >= 0) pending.push_back(static_cast<size_t>(worker.job));
+        stopWorker(worker);
+    }
+    for (const size_t index : pending) {
+        ++failed;
+        std::cout << "job " << jobs[index].line << " " << jobs[index].spec.outputPath << " failed 0s not run" << std::endl;
+    }
+
+    std::cout << "done: " << succeeded << " succeeded, " << failed << " failed";
+    if (!claimDir.empty()) std::cout << ", " << skipped << " claimed elsewhere";
+    std::cout << ", " << secondsSince(start) << "s" << std::endl;
+
+    return failed == 0 ? 0 : 1;
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// One line of a coordinator manifest
+struct FillJobSpec {
+    std::string imagePath;
+    std::string maskPath;
+    std::string outputPath;
+    std::string method;
+};
+
+using RunJobFunction = std::function<int(const FillJobSpec&)>;
+using EstimateCostFunction = std::function<double(const FillJobSpec&)>;
+
+/**
+ * @brief Runs every job of a manifest on a pool of local worker processes.
+ *
+ * The manifest holds one job per line as '<image> <mask> <output> <fill_method>'; empty lines and
+ * lines starting with '#' are skipped. Jobs are ordered by decreasing estimated cost and handed to
+ * whichever worker becomes idle first, so the most expensive jobs start early. Workers are copies of
+ * this executable started with --worker and talk to the coordinator over pipes. A worker that dies is
+ * restarted and its job is retried once. A line with the timing of every job is written to stdout
+ * as soon as it finishes.
+ *
+ * When claimDir is not empty, a job is only run after atomically creating '<claimDir>/job-<line>.claim'.
+ * Coordinators on several machines running the same manifest against a shared claim directory
+ * therefore split the jobs between them.
+ *
+ * @param executable Path of this executable, used to start the workers
+ * @param manifestPath Path of the manifest file
+ * @param workerCount Number of worker processes
+ * @param claimDir Shared directory for job claims, or empty to run every job
+ * @param estimateCost Returns the relative cost of a job
+ * @return 0 if every job succeeded, 1 otherwise
+ */
+int runCoordinator(const char* executable, const std::string& manifestPath, size_t workerCount,
+                   const std::string& claimDir, const EstimateCostFunction& estimateCost);
+
+/**
+ * @brief Serves jobs sent by a coordinator on stdin until stdin is closed.
+ *
+ * @param runJob Runs one job and returns 0 on success
+ * @return 0
+ */
+int runWorker(const RunJobFunction& runJob);
@@ -1,10 +1,20 @@
 #include <vector>
-#include <set>
+#include <bit>
 #include <limits>
 #include <cmath>
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
 
 #include "holefill.h"
+#include "parallel.h"
+#include "kernels.h"
+#include "holespans.h"
+#include "holefill_mask.h"
+#include "occupancy.h"
+#include "profile.h"
+#include "scratch.h"
 #include "nanoflann.hpp"
 
 namespace holefill {
@@ -13,198 +23,981 @@ inline float getPixel(const float* const image, const int32_t x, const int32_t y
     return image[y * width + x];
 }
 
-std::vector<Coord> findBoundaryPixels(const float* const image, const int32_t width, const int32_t height, const std::vector<Coord>& holePixels, const bool use8Connectivity = true) {
-    std::vector<Coord> boundaryPixels;
-    std::set<Coord> holeSet(holePixels.begin(), holePixels.end());
-    std::set<Coord> boundarySet;  // to avoid duplicates
-
+// A boundary pixel is emitted by its first hole neighbor in row-major order, which removes duplicates
+// without a set. The pixels are counted first so the result is allocated exactly once.
+//
+// Only hole pixels that can have a valid neighbor are examined: the ends of each span and the
+// pixels next to a gap between the spans of the rows above and below. Inside a hole, whole
+// spans are passed over by comparing them with the spans of the adjacent rows.
+std::pmr::vector<Coord> findBoundaryPixels(const float* const image, const int32_t width, const int32_t height,
+                                           const HoleSpans& holes, std::pmr::memory_resource* const resource,
+                                           const bool use8Connectivity) {
     // Neighbor offsets
-    std::vector<Coord> offsets = {
-        {-1, 0}, {1, 0}, {0, -1}, {0, 1}
+    const Coord offsets[8] = {
+        {-1, 0}, {1, 0}, {0, -1}, {0, 1},
+        {-1, -1}, {-1, 1}, {1, -1}, {1, 1}
+    };
+    const int offsetCount = use8Connectivity ? 8 : 4;
+
+    const auto isHole = [&](const int32_t x, const int32_t y) {
+        return y >= 0 && y < height && x >= 0 && x < width && getPixel(image, x, y, width) < 0.0f;
     };
-    if (use8Connectivity) {
-        offsets.insert(offsets.end(), {
-            {-1, -1}, {-1, 1}, {1, -1}, {1, 1}
-        });
-    }
 
-    for (const Coord& p : holePixels) {
-        for (const Coord& off : offsets) {
-            const int32_t nx = p.x + off.x;
-            const int32_t ny = p.y + off.y;
+    const auto visitPixel = [&](const int32_t x, const int32_t y, const auto& emit) {
+        for (int o = 0; o < offsetCount; ++o) {
+            const int32_t nx = x + offsets[o].x;
+            const int32_t ny = y + offsets[o].y;
 
-            if (ny >= 0 && ny < height && nx >= 0 && nx < width) {
-                const Coord neighbor{nx, ny};
+            if (ny < 0 || ny >= height || nx < 0 || nx >= width || !(getPixel(image, nx, ny, width) >= 0.0f)) continue;
 
-                if (holeSet.count(neighbor) == 0 && getPixel(image, nx, ny, width) >= 0.0f) {
-                    if (boundarySet.insert(neighbor).second) {
-                        boundaryPixels.push_back(neighbor);
-                    }
+            bool first = true;
+            for (int e = 0; e < offsetCount && first; ++e) {
+                const int32_t hx = nx + offsets[e].x;
+                const int32_t hy = ny + offsets[e].y;
+                first = !((hy < y || (hy == y && hx < x)) && isHole(hx, hy));
+            }
+
+            if (first) {
+                emit(Coord{nx, ny});
+            }
+        }
+    };
+
+    const std::pmr::vector<HoleSpan>& spans = holes.spans;
+
+    // First pixel at or after x on the given row that is not a hole. Queries of each cursor must
+    // not move backwards, so every cursor passes over the spans once.
+    const auto nextNonHole = [&](size_t& cursor, const int32_t row, const int32_t x) {
+        while (cursor < spans.size() && (spans[cursor].y < row || (spans[cursor].y == row && spans[cursor].x1 <= x))) {
+            ++cursor;
+        }
+        return (cursor < spans.size() && spans[cursor].y == row && spans[cursor].x0 <= x) ? spans[cursor].x1 : x;
+    };
+
+    const auto forEachBoundaryPixel = [&](const auto& emit) {
+        size_t above = 0;
+        size_t below = 0;
+        for (const HoleSpan& span : spans) {
+            for (int32_t x = span.x0; x < span.x1;) {
+                // Next pixel of the span that may touch a valid pixel: a pixel borders a non-hole
+                // pixel of an adjacent row if the first one at or after x - 1 is at most x + 1
+                int32_t candidate = (x == span.x0) ? x : span.x1 - 1;
+                if (span.y > 0) {
+                    const int32_t gap = nextNonHole(above, span.y - 1, std::max(x - 1, 0));
+                    if (gap < width) candidate = std::min(candidate, std::max(x, gap - 1));
                 }
+                if (span.y + 1 < height) {
+                    const int32_t gap = nextNonHole(below, span.y + 1, std::max(x - 1, 0));
+                    if (gap < width) candidate = std::min(candidate, std::max(x, gap - 1));
+                }
+
+                visitPixel(candidate, span.y, emit);
+                x = candidate + 1;
             }
         }
-    }
+    };
+
+    size_t count = 0;
+    forEachBoundaryPixel([&](const Coord&) { ++count; });
+
+    std::pmr::vector<Coord> boundaryPixels(resource);
+    boundaryPixels.reserve(count);
+    forEachBoundaryPixel([&](const Coord& v) { boundaryPixels.push_back(v); });
 
     return boundaryPixels;
 };
 
-std::vector<Coord> findHolePixels(const float* const image, const uint32_t width, const uint32_t height) {
-    std::vector<Coord> holePixels;
+std::pmr::vector<Coord> findHolePixels(const HoleSpans& holes, std::pmr::memory_resource* const resource) {
+    std::pmr::vector<Coord> holePixels(resource);
+    holePixels.reserve(holes.pixelCount);
+    holes.forEachPixel([&](const int32_t x, const int32_t y) { holePixels.push_back({x, y}); });
+    return holePixels;
+}
 
-    for (uint32_t y = 0; y < height; ++y) {
-        for (uint32_t x = 0; x < width; ++x) {
-            if (getPixel(image, x, y, width) < 0.0f) {
-                holePixels.emplace_back(x, y);
-            }
-        }
+// Deterministic reductions sum the boundary in chunks of this many pixels, each in order, and
+// combine the chunk sums in a pairwise tree that depends only on the number of chunks, so the
+// order of every addition is fixed by the boundary alone. Pairwise summation also keeps the
+// rounding error from growing linearly with the size of the boundary.
+constexpr size_t reductionChunkSize = 1024;
+
+struct WeightedSum {
+    float numerator = 0.0f;
+    float denominator = 0.0f;
+};
+
+inline WeightedSum operator+(const WeightedSum& a, const WeightedSum& b) {
+    return {a.numerator + b.numerator, a.denominator + b.denominator};
+}
+
+inline float averageOf(const WeightedSum& sum) {
+    return (sum.denominator > std::numeric_limits<float>::epsilon())
+        ? sum.numerator / sum.denominator
+        : 0.0f;  // Fallback value
+}
+
+// Sum over boundaryPixels[begin, end) in order
+WeightedSum weightedSum(const float* const image, const int32_t width, const Coord& u,
+                        const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc,
+                        const size_t begin, const size_t end) {
+    WeightedSum sum;
+    for (size_t i = begin; i < end; ++i) {
+        const Coord& v = boundaryPixels[i];
+        const float w = weightFunc(u, v);
+        const float intensity = getPixel(image, v.x, v.y, width);
+        sum.numerator += w * intensity;
+        sum.denominator += w;
     }
+    return sum;
+}
 
-    return holePixels;
+// Combines chunkSum(c) for the chunks c in [first, last) pairwise
+template <typename ChunkSum>
+WeightedSum pairwiseSum(const size_t first, const size_t last, const ChunkSum& chunkSum) {
+    if (last - first == 1) return chunkSum(first);
+    const size_t middle = first + (last - first) / 2;
+    return pairwiseSum(first, middle, chunkSum) + pairwiseSum(middle, last, chunkSum);
 }
 
-void fill(float* const image, const int32_t width, const int32_t height, const WeightFunction weightFunc) {
-    const std::vector<Coord> holePixels = findHolePixels(image, width, height);
-    const std::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holePixels);
+inline size_t reductionChunkCount(const size_t count) {
+    return (count + reductionChunkSize - 1) / reductionChunkSize;
+}
 
-    for (const auto& u : holePixels) {
-        float numerator = 0.0f;
-        float denominator = 0.0f;
+// Sum over all boundary pixels, chunked and combined pairwise when deterministic
+WeightedSum boundarySum(const float* const image, const int32_t width, const Coord& u,
+                        const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc,
+                        const bool deterministic) {
+    if (!deterministic || boundaryPixels.size() <= reductionChunkSize) {
+        return weightedSum(image, width, u, boundaryPixels, weightFunc, 0, boundaryPixels.size());
+    }
 
-        for (const auto& v : boundaryPixels) {
-            const float w = weightFunc(u, v);
-            const float intensity = getPixel(image, v.x, v.y, width);
-            numerator += w * intensity;
-            denominator += w;
+    return pairwiseSum(0, reductionChunkCount(boundaryPixels.size()), [&](const size_t c) {
+        return weightedSum(image, width, u, boundaryPixels, weightFunc, c * reductionChunkSize,
+                           std::min(boundaryPixels.size(), (c + 1) * reductionChunkSize));
+    });
+}
+
+float weightedAverage(const float* const image, const int32_t width, const Coord& u,
+                      const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc,
+                      const bool deterministic) {
+    return averageOf(boundarySum(image, width, u, boundaryPixels, weightFunc, deterministic));
+}
+
+// Replaces every hole pixel with the weighted average of all boundary pixels, one span of hole
+// pixels per task. Hole pixels are visited span by span, so no list of them is kept.
+void fillFromBoundary(float* const image, const int32_t width, const HoleSpans& holes,
+                      const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc,
+                      const bool deterministic, ScratchResource& scratch) {
+    scratch.enterPhase(FillPhase::Query);
+    parallelFor(holes.spans.size(), [&](const size_t s) {
+        scratch.checkCancelled();
+        const HoleSpan& span = holes.spans[s];
+        for (int32_t x = span.x0; x < span.x1; ++x) {
+            image[span.y * width + x] = weightedAverage(image, width, Coord{x, span.y}, boundaryPixels, weightFunc,
+                                                        deterministic);
         }
+    });
+}
 
-        image[u.y * width + u.x] = (denominator > std::numeric_limits<float>::epsilon())
-            ? numerator / denominator
-            : 0.0f;  // Fallback value
-    }
+void fill(float* const image, const int32_t width, const int32_t height, const WeightFunction weightFunc,
+          const FillOptions& options) {
+    ScratchResource scratch(options);
+    const HoleSpans holes(image, width, height, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+    fillFromBoundary(image, width, holes, boundaryPixels, weightFunc, options.deterministic, scratch);
 }
 
-void fillApproximate(float* const image, const int32_t width, const int32_t height) {
-    const std::vector<Coord> holePixels = findHolePixels(image, width, height);
-    std::vector<std::vector<bool>> isHole(height, std::vector<bool>(width, false));
-    std::queue<Coord> toProcess;
+// Copies the image into the output of every setting, one row per task
+void copyToOutputs(const float* const image, const int32_t width, const int32_t height,
+                   const std::span<const SweepSetting> settings) {
+    parallelFor(settings.size() * static_cast<size_t>(height), [&](const size_t task) {
+        const size_t offset = (task % static_cast<size_t>(height)) * static_cast<size_t>(width);
+        std::copy(image + offset, image + offset + width, settings[task / static_cast<size_t>(height)].output + offset);
+    });
+}
 
-    // Initialize hole mask and queue
-    for (const auto& p : holePixels) {
-        isHole[p.y][p.x] = true;
+// Defined here rather than in the header so that callers built without -ffp-contract=off round the same way
+float PowerKernel::operator()(const Coord& u, const Coord& v) const {
+    const float dx = static_cast<float>(u.x - v.x);
+    const float dy = static_cast<float>(u.y - v.y);
+    return weight(std::log(dx * dx + dy * dy + epsilon));
+}
+
+float PowerKernel::weight(const float logDistance) const {
+    return std::exp(-zeta * logDistance);
+}
+
+// Weights of the settings of a sweep. Settings with a kernel share the squared distance of a pair of
+// pixels and its logarithm per distinct epsilon; the others call their weight function.
+struct SweepWeights {
+    static constexpr size_t noKernel = std::numeric_limits<size_t>::max();
+
+    std::span<const SweepSetting> settings;
+    std::pmr::vector<float> epsilons;
+    std::pmr::vector<size_t> slots;   // Index into epsilons of each setting, noKernel without a kernel
+
+    SweepWeights(const std::span<const SweepSetting> settings, std::pmr::memory_resource* const resource)
+        : settings(settings), epsilons(resource), slots(settings.size(), noKernel, resource) {
+        for (size_t t = 0; t < settings.size(); ++t) {
+            if (!settings[t].kernel) continue;
+            const auto it = std::find(epsilons.begin(), epsilons.end(), settings[t].kernel->epsilon);
+            slots[t] = static_cast<size_t>(it - epsilons.begin());
+            if (it == epsilons.end()) epsilons.push_back(settings[t].kernel->epsilon);
+        }
     }
 
-    // 4-connected neighbor offsets
-    const int32_t offsets[8][2] = {
-        {-1, 0}, {1, 0}, {0, -1}, {0, 1},
-        {-1, -1}, {-1, 1}, {1, -1}, {1, 1}
+    // Computes log(d² + epsilon) of the pair (u, v) for every distinct epsilon into logs
+    void logDistances(const Coord& u, const Coord& v, float* const logs) const {
+        if (epsilons.empty()) return;
+        const float dx = static_cast<float>(u.x - v.x);
+        const float dy = static_cast<float>(u.y - v.y);
+        const float distanceSquared = dx * dx + dy * dy;
+        for (size_t e = 0; e < epsilons.size(); ++e) logs[e] = std::log(distanceSquared + epsilons[e]);
+    }
+
+    // Weight of setting t for the pair (u, v) whose logDistances are in logs, the same as the
+    // setting's kernel or weight function gives
+    float weight(const size_t t, const Coord& u, const Coord& v, const float* const logs) const {
+        return (slots[t] == noKernel) ? settings[t].weightFunc(u, v) : settings[t].kernel->weight(logs[slots[t]]);
+    }
+};
+
+// Sums of every setting over boundaryPixels[begin, end) in order, each as weightedSum sums it
+void weightedSums(const float* const image, const int32_t width, const Coord& u,
+                  const std::pmr::vector<Coord>& boundaryPixels, const SweepWeights& sweepWeights,
+                  const size_t begin, const size_t end, float* const logs, WeightedSum* const sums) {
+    const size_t n = sweepWeights.settings.size();
+    std::fill(sums, sums + n, WeightedSum{});
+    for (size_t i = begin; i < end; ++i) {
+        const Coord& v = boundaryPixels[i];
+        const float intensity = getPixel(image, v.x, v.y, width);
+        sweepWeights.logDistances(u, v, logs);
+        for (size_t t = 0; t < n; ++t) {
+            const float w = sweepWeights.weight(t, u, v, logs);
+            sums[t].numerator += w * intensity;
+            sums[t].denominator += w;
+        }
+    }
+}
+
+void fillSweep(const float* const image, const int32_t width, const int32_t height,
+               const std::span<const SweepSetting> settings, const FillOptions& options) {
+    ScratchResource scratch(options);
+    if (settings.empty()) return;
+    copyToOutputs(image, width, height, settings);
+    const HoleSpans holes(image, width, height, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    // Chunks are summed as weightedAverage sums them, so each output matches fill()
+    const bool chunked = options.deterministic && boundaryPixels.size() > reductionChunkSize;
+    const size_t chunks = chunked ? reductionChunkCount(boundaryPixels.size()) : 1;
+    const size_t n = settings.size();
+    const SweepWeights sweepWeights(settings, &scratch);
+
+    scratch.enterPhase(FillPhase::Query);
+    parallelFor(holes.spans.size(), [&](const size_t s) {
+        scratch.checkCancelled();
+        const HoleSpan& span = holes.spans[s];
+        std::pmr::vector<WeightedSum> sums(chunks * n, &scratch);
+        std::pmr::vector<float> logs(sweepWeights.epsilons.size(), &scratch);
+
+        for (int32_t x = span.x0; x < span.x1; ++x) {
+            const Coord u{x, span.y};
+            for (size_t c = 0; c < chunks; ++c) {
+                weightedSums(image, width, u, boundaryPixels, sweepWeights, c * reductionChunkSize,
+                             chunked ? std::min(boundaryPixels.size(), (c + 1) * reductionChunkSize) : boundaryPixels.size(),
+                             logs.data(), &sums[c * n]);
+            }
+            for (size_t t = 0; t < n; ++t) {
+                const WeightedSum total = chunked
+                    ? pairwiseSum(0, chunks, [&](const size_t c) { return sums[c * n + t]; })
+                    : sums[t];
+                settings[t].output[static_cast<size_t>(span.y) * width + x] = averageOf(total);
+            }
+        }
+    });
+}
+
+// Fills the holes one boundary layer per sweep. Needs no scratch memory: pixels of the current
+// layer are marked in the image itself. With an occupancy index, sweeps only visit the tiles with holes.
+void fillApproximateBySweeps(float* const image, const int32_t width, const int32_t height,
+                             const int32_t (&offsets)[8][2], const TileOccupancy* const occupancy,
+                             ScratchResource& scratch) {
+    scratch.enterPhase(FillPhase::Query);
+    constexpr float pending = -1.0f;
+    constexpr float layer = -2.0f;
+
+    const auto isValid = [&](const int32_t x, const int32_t y) {
+        return x >= 0 && x < width && y >= 0 && y < height && image[y * width + x] >= 0.0f;
+    };
+
+    const auto forEachPixel = [&](const auto& visit) {
+        if (occupancy) {
+            occupancy->forEachPixel(visit);
+            return;
+        }
+        for (int32_t y = 0; y < height; ++y) {
+            for (int32_t x = 0; x < width; ++x) visit(x, y);
+        }
     };
 
-    // First pass: find boundary pixels and add them to queue
-    for (const auto& p : holePixels) {
-        for (const auto& offset : offsets) {
-            int nx = p.x + offset[0];
-            int ny = p.y + offset[1];
+    forEachPixel([&](const int32_t x, const int32_t y) {
+        if (image[y * width + x] < 0.0f) image[y * width + x] = pending;
+    });
 
-            if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                if (!isHole[ny][nx] && image[ny * width + nx] >= 0.0f) {
-                    toProcess.push(p);
+    for (bool marked = true; marked;) {
+        scratch.checkCancelled();
+
+        // Mark the hole pixels next to valid pixels
+        marked = false;
+        forEachPixel([&](const int32_t x, const int32_t y) {
+            if (image[y * width + x] != pending) return;
+            for (const auto& offset : offsets) {
+                if (isValid(x + offset[0], y + offset[1])) {
+                    image[y * width + x] = layer;
+                    marked = true;
                     break;
                 }
             }
+        });
+
+        // Fill them in scan order, so earlier pixels of the layer already count as valid
+        forEachPixel([&](const int32_t x, const int32_t y) {
+            if (image[y * width + x] != layer) return;
+
+            float sum = 0.0f;
+            int32_t count = 0;
+            for (const auto& offset : offsets) {
+                if (isValid(x + offset[0], y + offset[1])) {
+                    sum += image[(y + offset[1]) * width + (x + offset[0])];
+                    ++count;
+                }
+            }
+            image[y * width + x] = sum / count;
+        });
+    }
+}
+
+// Pixels of fillApproximate as the image stores them, row after row
+struct RowMajorPixels {
+    float* image;
+    int32_t width;
+    int32_t height;
+
+    float& operator()(const int32_t x, const int32_t y) const {
+        return image[static_cast<size_t>(y) * width + x];
+    }
+
+    // Pointers to the neighbors of a pixel at the given offsets, null outside the image
+    void neighbors(const int32_t x, const int32_t y, const int32_t (&offsets)[8][2], float* (&out)[8]) const {
+        for (size_t i = 0; i < 8; ++i) {
+            const int32_t nx = x + offsets[i][0];
+            const int32_t ny = y + offsets[i][1];
+            out[i] = (nx >= 0 && nx < width && ny >= 0 && ny < height) ? &(*this)(nx, ny) : nullptr;
         }
     }
+};
 
-    // Process pixels in order
-    while (!toProcess.empty()) {
-        const Coord u = toProcess.front();
-        toProcess.pop();
+// Pixels of fillApproximate copied into 16×16 tiles of 1 KiB, the tiles row after row. The 8-neighborhood
+// of a pixel then lies in at most four tiles next to each other, where in a wide image its three rows
+// are pages apart, and the pixels the queue visits along the edge of a hole share tiles in both directions.
+// The copy has a frame of NaN where it reaches past the image, which is neither valid nor a hole, so
+// neighbors need no bounds checks.
+struct BlockedPixels {
+    static constexpr int32_t tileShift = 4;
+    static constexpr int32_t tileSize = 1 << tileShift;
+
+    float* tiles;
+    int32_t tilesX;
 
-        if (!isHole[u.y][u.x]) continue;  // Skip if already processed
+    float& operator()(const int32_t x, const int32_t y) const {
+        const size_t tile = static_cast<size_t>(y >> tileShift) * tilesX + static_cast<size_t>(x >> tileShift);
+        return tiles[(tile << (2 * tileShift)) + static_cast<size_t>(((y & (tileSize - 1)) << tileShift) | (x & (tileSize - 1)))];
+    }
+
+    // Pointers to the neighbors of a pixel at the given offsets; inside a tile they are at fixed distances
+    void neighbors(const int32_t x, const int32_t y, const int32_t (&offsets)[8][2], float* (&out)[8]) const {
+        const int32_t tx = x & (tileSize - 1);
+        const int32_t ty = y & (tileSize - 1);
+        if (tx > 0 && tx < tileSize - 1 && ty > 0 && ty < tileSize - 1) {
+            float* const center = &(*this)(x, y);
+            for (size_t i = 0; i < 8; ++i) out[i] = center + offsets[i][1] * tileSize + offsets[i][0];
+            return;
+        }
+        for (size_t i = 0; i < 8; ++i) out[i] = &(*this)(x + offsets[i][0], y + offsets[i][1]);
+    }
+};
+
+// Fills the holes breadth-first from their boundary inward, over the pixels of a box at origin in the
+// image that holds the holes and their neighbors. Hole pixels already in the queue are marked in the
+// pixels themselves.
+template <typename Pixels>
+void fillApproximateByQueue(const Pixels& pixels, const Coord origin, const HoleSpans& holes,
+                            const int32_t (&offsets)[8][2], std::pmr::vector<Coord>& toProcess,
+                            ScratchResource& scratch) {
+    constexpr float queued = -2.0f;
+
+    const auto isValid = [](const float* const pixel) {
+        return pixel && *pixel >= 0.0f;
+    };
+
+    // First pass: find hole pixels next to valid pixels and add them to the queue
+    float* neighbor[8];
+    holes.forEachPixel([&](int32_t x, int32_t y) {
+        x -= origin.x;
+        y -= origin.y;
+        float& pixel = pixels(x, y);
+        pixel = -1.0f;
+
+        pixels.neighbors(x, y, offsets, neighbor);
+        for (const float* const n : neighbor) {
+            if (isValid(n)) {
+                pixel = queued;
+                toProcess.push_back({x, y});
+                break;
+            }
+        }
+    });
+
+    // Process pixels in order
+    scratch.enterPhase(FillPhase::Query);
+    for (size_t head = 0; head < toProcess.size(); ++head) {
+        if (head % 4096 == 0) scratch.checkCancelled();
+        const Coord u = toProcess[head];
+        pixels.neighbors(u.x, u.y, offsets, neighbor);
 
         float sum = 0.0f;
         int32_t count = 0;
 
         // Calculate average of non-hole neighbors
-        for (const auto& offset : offsets) {
-            const int32_t nx = u.x + offset[0];
-            const int32_t ny = u.y + offset[1];
+        for (const float* const n : neighbor) {
+            if (isValid(n)) {
+                sum += *n;
+                ++count;
+            }
+        }
 
-            if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                if (!isHole[ny][nx] && image[ny * width + nx] >= 0.0f) {
-                    sum += image[ny * width + nx];
-                    ++count;
-                }
+        pixels(u.x, u.y) = sum / count;
+
+        // Add unqueued hole neighbors to the queue
+        for (size_t i = 0; i < 8; ++i) {
+            if (neighbor[i] && *neighbor[i] < 0.0f && *neighbor[i] != queued) {
+                *neighbor[i] = queued;
+                toProcess.push_back({u.x + offsets[i][0], u.y + offsets[i][1]});
             }
         }
+    }
+}
 
-        if (count > 0) {
-            image[u.y * width + u.x] = sum / count;
-            isHole[u.y][u.x] = false;  // Mark as processed
+void fillApproximate(float* const image, const int32_t width, const int32_t height, const FillOptions& options) {
+    ScratchResource scratch(options);
 
-            // Add unprocessed hole neighbors to queue
-            for (const auto& offset : offsets) {
-                const int32_t nx = u.x + offset[0];
-                const int32_t ny = u.y + offset[1];
+    // 8-connected neighbor offsets
+    const int32_t offsets[8][2] = {
+        {-1, 0}, {1, 0}, {0, -1}, {0, 1},
+        {-1, -1}, {-1, 1}, {1, -1}, {1, 1}
+    };
+
+    // Every hole pixel enters the queue at most once, so the queue is a vector of fixed capacity
+    std::optional<TileOccupancy> occupancy;
+    std::optional<HoleSpans> holes;
+    std::pmr::vector<Coord> toProcess(&scratch);
+    try {
+        occupancy.emplace(image, width, height, &scratch);
+        if (occupancy->empty()) return;
+        holes.emplace(image, *occupancy, &scratch);
+        toProcess.reserve(holes->pixelCount);
+    } catch (const MemoryBudgetExceeded&) {
+        scratch.degrade();
+        fillApproximateBySweeps(image, width, height, offsets, occupancy ? &*occupancy : nullptr, scratch);
+        return;
+    }
+
+    scratch.enterPhase(FillPhase::Boundary);
+
+    // Box of the holes and their neighbors. On wide boxes the fill runs in a tiled copy of it.
+    int32_t x0 = width;
+    int32_t x1 = 0;
+    for (const HoleSpan& span : holes->spans) {
+        x0 = std::min(x0, span.x0);
+        x1 = std::max(x1, span.x1);
+    }
+    const Coord origin{x0 - 1, holes->spans.front().y - 1};
+    const int32_t boxWidth = x1 - x0 + 2;
+    const int32_t boxHeight = holes->spans.back().y - origin.y + 2;
 
-                if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                    if (isHole[ny][nx]) {
-                        toProcess.push({nx, ny});
+    // Copying a box the holes fill sparsely costs more than it saves
+    const size_t boxArea = static_cast<size_t>(boxWidth) * boxHeight;
+    std::pmr::vector<float> tiles(&scratch);
+    if (static_cast<size_t>(boxWidth) >= tuning().blockedLayoutMinWidth && holes->pixelCount * 8 >= boxArea) {
+        const int32_t tilesX = (boxWidth + BlockedPixels::tileSize - 1) / BlockedPixels::tileSize;
+        const int32_t tilesY = (boxHeight + BlockedPixels::tileSize - 1) / BlockedPixels::tileSize;
+        try {
+            tiles.resize(static_cast<size_t>(tilesX) * tilesY * BlockedPixels::tileSize * BlockedPixels::tileSize);
+        } catch (const MemoryBudgetExceeded&) {
+            scratch.degrade();
+        }
+
+        if (!tiles.empty()) {
+            const BlockedPixels blocked{tiles.data(), tilesX};
+            parallelFor(static_cast<size_t>(tilesY), [&](const size_t ty) {
+                const int32_t rowEnd = std::min(boxHeight, static_cast<int32_t>(ty + 1) * BlockedPixels::tileSize);
+                for (int32_t y = static_cast<int32_t>(ty) * BlockedPixels::tileSize; y < rowEnd; ++y) {
+                    const int32_t imageY = origin.y + y;
+                    for (int32_t x = 0; x < boxWidth; ++x) {
+                        const int32_t imageX = origin.x + x;
+                        blocked(x, y) = (imageX >= 0 && imageX < width && imageY >= 0 && imageY < height)
+                            ? image[static_cast<size_t>(imageY) * width + imageX]
+                            : std::numeric_limits<float>::quiet_NaN();
                     }
                 }
-            }
+            });
+
+            fillApproximateByQueue(blocked, origin, *holes, offsets, toProcess, scratch);
+
+            // Only hole pixels changed
+            parallelFor(holes->spans.size(), [&](const size_t s) {
+                const HoleSpan& span = holes->spans[s];
+                float* const row = image + static_cast<size_t>(span.y) * width;
+                for (int32_t x = span.x0; x < span.x1; ++x) row[x] = blocked(x - origin.x, span.y - origin.y);
+            });
+            return;
         }
     }
+
+    fillApproximateByQueue(RowMajorPixels{image, width, height}, Coord{0, 0}, *holes, offsets, toProcess, scratch);
 }
 
+
 // Adaptor for nanoflann
 struct CoordCloud {
-    std::vector<Coord> points;
+    const std::pmr::vector<Coord>* points;
 
-    size_t kdtree_get_point_count() const { return points.size(); }
+    size_t kdtree_get_point_count() const { return points->size(); }
 
     float kdtree_get_pt(const size_t idx, const size_t dim) const {
-        return (dim == 0) ? static_cast<float>(points[idx].x)
-                          : static_cast<float>(points[idx].y);
+        return (dim == 0) ? static_cast<float>((*points)[idx].x)
+                          : static_cast<float>((*points)[idx].y);
     }
 
     template <class BBOX>
     bool kdtree_get_bbox(BBOX&) const { return false; }
 };
 
-void fillExactWithSearch(float* const image, const int32_t width, const int32_t height,
-                         const WeightFunction weightFunc, const size_t nearestNeighborMax) {
-    const std::vector<Coord> holePixels = findHolePixels(image, width, height);
-    const std::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holePixels);
+// Per-query bounded max-heaps of the k best (distance, index) pairs, stored contiguously. Pairs are
+// ordered by distance, then by index, so which of several equally distant neighbors are kept does
+// not depend on the order in which they are offered.
+template <typename Distance>
+struct NeighborHeaps {
+    size_t k;
+    std::pmr::vector<Distance> distances;
+    std::pmr::vector<size_t> indices;
+    std::pmr::vector<size_t> sizes;
 
-    CoordCloud cloud;
-    cloud.points = boundaryPixels;
+    NeighborHeaps(const size_t queryCount, const size_t k, std::pmr::memory_resource* const resource)
+        : k(k), distances(queryCount * k, resource), indices(queryCount * k, resource), sizes(queryCount, 0, resource) {}
 
-    using KDTree = nanoflann::KDTreeSingleIndexAdaptor<
-        nanoflann::L2_Simple_Adaptor<float, CoordCloud>,
-        CoordCloud, 2, size_t>;
+    Distance worst(const size_t q) const {
+        return sizes[q] < k ? std::numeric_limits<Distance>::max() : distances[q * k];
+    }
 
-    KDTree tree(2, cloud, {10});
-    tree.buildIndex();
+    static bool closer(const Distance a, const size_t aIndex, const Distance b, const size_t bIndex) {
+        return a < b || (a == b && aIndex < bIndex);
+    }
+
+    void push(const size_t q, const Distance distance, const size_t index) {
+        Distance* const d = &distances[q * k];
+        size_t* const i = &indices[q * k];
+        size_t& size = sizes[q];
 
-    const size_t k = nearestNeighborMax;  // Number of nearest neighbors
+        if (size < k) {
+            // Sift up
+            size_t child = size++;
+            while (child > 0) {
+                const size_t parent = (child - 1) / 2;
+                if (!closer(d[parent], i[parent], distance, index)) break;
+                d[child] = d[parent];
+                i[child] = i[parent];
+                child = parent;
+            }
+            d[child] = distance;
+            i[child] = index;
+            return;
+        }
+
+        if (!closer(distance, index, d[0], i[0])) return;
+
+        // Replace the root and sift down
+        size_t parent = 0;
+        for (;;) {
+            size_t child = 2 * parent + 1;
+            if (child >= k) break;
+            if (child + 1 < k && closer(d[child], i[child], d[child + 1], i[child + 1])) ++child;
+            if (!closer(distance, index, d[child], i[child])) break;
+            d[parent] = d[child];
+            i[parent] = i[child];
+            parent = child;
+        }
+        d[parent] = distance;
+        i[parent] = index;
+    }
+};
 
-    for (const Coord& u : holePixels) {
-        const float queryPt[2] = { static_cast<float>(u.x), static_cast<float>(u.y) };
+// Flattened KD-tree over boundary pixels. Nodes are stored breadth-first in one array and
+// leaves keep coordinates inline in structure-of-arrays form, so a query touches contiguous
+// memory and compares integer squared distances. Neighbors are reported by pixel index
+// y * width + x, which breaks ties the same way whatever the leaf size.
+struct FlatBoundaryIndex {
+    struct Node {
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+        uint32_t first;   // Left child for inner nodes (right child is first + 1), first point for leaves
+        uint32_t count;   // 0 for inner nodes
+    };
 
-        std::vector<size_t> indices(k);
-        std::vector<float> distances(k);
+    // Integer squared distances fit in 32 bits as long as both coordinates differ by less than this
+    static constexpr int32_t maxExtent = 46340;
+
+    size_t width;
+    std::pmr::vector<Node> nodes;
+    std::pmr::vector<int32_t> xs;
+    std::pmr::vector<int32_t> ys;
+
+    // A maxLeafSize at least as large as the boundary gives a single leaf, i.e. a brute-force scan
+    FlatBoundaryIndex(const int32_t width, const std::pmr::vector<Coord>& boundaryPixels,
+                      std::pmr::memory_resource* const resource, const size_t maxLeafSize)
+        : width(static_cast<size_t>(width)), nodes(resource), xs(resource), ys(resource) {
+        if (boundaryPixels.size() <= maxLeafSize) {
+            // A single leaf keeps the boundary order, so the arrays are filled directly
+            xs.resize(boundaryPixels.size());
+            ys.resize(boundaryPixels.size());
+            for (size_t i = 0; i < boundaryPixels.size(); ++i) {
+                xs[i] = boundaryPixels[i].x;
+                ys[i] = boundaryPixels[i].y;
+            }
+            if (!boundaryPixels.empty()) {
+                nodes.push_back({*std::min_element(xs.begin(), xs.end()), *std::min_element(ys.begin(), ys.end()),
+                                 *std::max_element(xs.begin(), xs.end()), *std::max_element(ys.begin(), ys.end()),
+                                 0, static_cast<uint32_t>(xs.size())});
+            }
+            return;
+        }
+
+        std::pmr::vector<Coord> points(boundaryPixels, resource);
+
+        {
+            // Breadth-first construction: children are appended in the order their parents are visited,
+            // so the ranges still to split are kept in a vector used as a queue
+            struct Range {
+                size_t node;
+                size_t begin;
+                size_t end;
+            };
+            std::pmr::vector<Range> pending(resource);
+            pending.reserve(4 * (points.size() / maxLeafSize) + 1);
+            nodes.push_back({});
+            pending.push_back({0, 0, points.size()});
+
+            for (size_t head = 0; head < pending.size(); ++head) {
+                const Range range = pending[head];
+
+                Node node{points[range.begin].x, points[range.begin].y, points[range.begin].x, points[range.begin].y, 0, 0};
+                for (size_t i = range.begin; i < range.end; ++i) {
+                    node.minX = std::min(node.minX, points[i].x);
+                    node.minY = std::min(node.minY, points[i].y);
+                    node.maxX = std::max(node.maxX, points[i].x);
+                    node.maxY = std::max(node.maxY, points[i].y);
+                }
+
+                if (range.end - range.begin <= maxLeafSize) {
+                    node.first = static_cast<uint32_t>(range.begin);
+                    node.count = static_cast<uint32_t>(range.end - range.begin);
+                } else {
+                    const bool splitX = (node.maxX - node.minX) >= (node.maxY - node.minY);
+                    const size_t middle = range.begin + (range.end - range.begin) / 2;
+                    std::nth_element(points.begin() + range.begin, points.begin() + middle, points.begin() + range.end,
+                                     [splitX](const Coord& a, const Coord& b) { return splitX ? a.x < b.x : a.y < b.y; });
+
+                    node.first = static_cast<uint32_t>(nodes.size());
+                    nodes.push_back({});
+                    nodes.push_back({});
+                    pending.push_back({node.first, range.begin, middle});
+                    pending.push_back({node.first + 1, middle, range.end});
+                }
+
+                nodes[range.node] = node;
+            }
+        }
+
+        // Partitioning keeps every leaf contiguous, so the points can be split into arrays as they are
+        xs.resize(points.size());
+        ys.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            xs[i] = points[i].x;
+            ys[i] = points[i].y;
+        }
+    }
+
+    static uint32_t boxDistanceSquared(const Node& node, const int32_t x, const int32_t y) {
+        const uint32_t dx = static_cast<uint32_t>(std::max({0, node.minX - x, x - node.maxX}));
+        const uint32_t dy = static_cast<uint32_t>(std::max({0, node.minY - y, y - node.maxY}));
+        return dx * dx + dy * dy;
+    }
+
+    // Offers points [first, first + count) within squared distance limit to slot q of heaps,
+    // skipping groups of points that cannot improve it
+    void scan(const uint32_t first, const uint32_t count, const int32_t x, const int32_t y,
+              NeighborHeaps<uint32_t>& heaps, const size_t q,
+              const uint32_t limit = std::numeric_limits<uint32_t>::max()) const {
+        const Kernels& k = kernels();
+        uint32_t distances[kernelBlockSize];
+        uint32_t groupMinima[kernelBlockSize / kernelGroupSize];
+
+        for (uint32_t block = first; block < first + count; block += kernelBlockSize) {
+            const uint32_t n = std::min<uint32_t>(kernelBlockSize, first + count - block);
+            k.squaredDistances(&xs[block], &ys[block], n, x, y, distances, groupMinima);
+
+            for (uint32_t begin = 0; begin < n; begin += kernelGroupSize) {
+                const uint32_t nearest = groupMinima[begin / kernelGroupSize];
+                // Points as far as the worst kept one may still win the tie on their index
+                if (nearest > heaps.worst(q) || nearest > limit) continue;
+
+                const uint32_t end = std::min(begin + kernelGroupSize, n);
+                for (uint32_t i = begin; i < end; ++i) {
+                    if (distances[i] <= limit) heaps.push(q, distances[i], pixelIndex(block + i));
+                }
+            }
+        }
+    }
+
+    size_t pixelIndex(const size_t point) const {
+        return static_cast<size_t>(ys[point]) * width + static_cast<size_t>(xs[point]);
+    }
 
-        tree.knnSearch(queryPt, k, indices.data(), distances.data());
+    // Collects the k nearest points of (x, y) into slot q of heaps
+    void search(const int32_t x, const int32_t y, NeighborHeaps<uint32_t>& heaps, const size_t q) const {
+        if (nodes.empty()) return;
 
+        uint32_t stack[64];
+        size_t top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (boxDistanceSquared(node, x, y) > heaps.worst(q)) continue;
+
+            if (node.count > 0) {
+                scan(node.first, node.count, x, y, heaps, q);
+                continue;
+            }
+
+            // Visit the closer child first by pushing it last
+            const uint32_t left = node.first;
+            const uint32_t right = node.first + 1;
+            if (boxDistanceSquared(nodes[left], x, y) <= boxDistanceSquared(nodes[right], x, y)) {
+                stack[top++] = right;
+                stack[top++] = left;
+            } else {
+                stack[top++] = left;
+                stack[top++] = right;
+            }
+        }
+    }
+};
+
+// Nanoflann index over the boundary, used where integer squared distances could overflow
+using CoordKDTree = nanoflann::KDTreeSingleIndexAdaptor<
+    nanoflann::L2_Simple_Adaptor<float, CoordCloud>,
+    CoordCloud, 2, size_t>;
+
+// Nanoflann result set that keeps the k nearest in slot q of heaps by pixel index, so that ties are
+// broken as in FlatBoundaryIndex. Leaves only offer points closer than worstDist(), which is therefore
+// just above the k-th distance.
+struct HeapResultSet {
+    using DistanceType = float;
+
+    NeighborHeaps<float>& heaps;
+    size_t q;
+    const std::pmr::vector<Coord>& points;
+    size_t width;
+
+    bool addPoint(const float distance, const size_t index) {
+        heaps.push(q, distance, static_cast<size_t>(points[index].y) * width + static_cast<size_t>(points[index].x));
+        return true;
+    }
+
+    float worstDist() const {
+        const float worst = heaps.worst(q);
+        return worst == std::numeric_limits<float>::max() ? worst : std::nextafter(worst, worst + 1.0f);
+    }
+
+    void sort() {}
+    bool full() const { return heaps.sizes[q] == heaps.k; }
+};
+
+// Floating point k-nearest neighbor search for images too large for FlatBoundaryIndex, calling visit as
+// forEachNearestBoundary does
+template <typename Visit>
+void forEachNearestBoundaryOfLargeImage(const float* const image, const int32_t width, const HoleSpans& holes,
+                                        const std::pmr::vector<Coord>& boundaryPixels, const size_t k,
+                                        ScratchResource& scratch, const Visit& visit) {
+    const CoordCloud cloud{&boundaryPixels};
+
+    NeighborHeaps<float> heaps(1, k, &scratch);
+    std::pmr::vector<std::pair<float, size_t>> neighbors(k, &scratch);
+
+    // Without budget for the tree every query scans the whole boundary
+    const size_t leafSize = tuning().floatTreeLeafSize;
+    std::optional<ScratchCharge> treeCharge;
+    try {
+        treeCharge.emplace(scratch, nanoflannIndexBytes(boundaryPixels.size(), leafSize));
+    } catch (const MemoryBudgetExceeded&) {
+        scratch.degrade();
+    }
+
+    std::optional<CoordKDTree> tree;
+    if (treeCharge) {
+        tree.emplace(2, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(leafSize));
+        tree->buildIndex();
+    }
+
+    scratch.enterPhase(FillPhase::Query);
+    holes.forEachPixel([&](const int32_t x, const int32_t y) {
+        scratch.checkCancelled();
+        heaps.sizes[0] = 0;
+        if (k == 0) {
+            // No boundary, fall through to the fallback value
+        } else if (tree) {
+            const float queryPt[2] = { static_cast<float>(x), static_cast<float>(y) };
+            HeapResultSet result{heaps, 0, boundaryPixels, static_cast<size_t>(width)};
+            tree->findNeighbors(result, queryPt);
+        } else {
+            for (const Coord& v : boundaryPixels) {
+                const float dx = static_cast<float>(v.x - x);
+                const float dy = static_cast<float>(v.y - y);
+                heaps.push(0, dx * dx + dy * dy, static_cast<size_t>(v.y) * width + static_cast<size_t>(v.x));
+            }
+        }
+
+        const size_t found = heaps.sizes[0];
+        for (size_t i = 0; i < found; ++i) neighbors[i] = {heaps.distances[i], heaps.indices[i]};
+        std::sort(neighbors.begin(), neighbors.begin() + found);
+
+        visit(Coord{x, y}, found, [&](const size_t i) {
+            const size_t p = neighbors[i].second;
+            return std::pair<Coord, float>{Coord{static_cast<int32_t>(p % width), static_cast<int32_t>(p / width)}, image[p]};
+        });
+    });
+}
+
+// Calls visit(u, found, neighbor) for every hole pixel u in row-major order, where neighbor(i) returns
+// the coordinates and the value of the i-th nearest of the found nearest boundary pixels of u, at most k
+template <typename Visit>
+void forEachNearestBoundary(const float* const image, const int32_t width, const int32_t height,
+                            const HoleSpans& holes, const std::pmr::vector<Coord>& boundaryPixels, const size_t k,
+                            ScratchResource& scratch, const Visit& visit) {
+    if (k == 0) {
+        // No boundary or no neighbors asked for, so every hole pixel gets the fallback value
+        scratch.enterPhase(FillPhase::Query);
+        holes.forEachPixel([&](const int32_t x, const int32_t y) {
+            scratch.checkCancelled();
+            visit(Coord{x, y}, 0, [](size_t) { return std::pair<Coord, float>{}; });
+        });
+        return;
+    }
+
+    scratch.enterPhase(FillPhase::IndexBuild);
+
+    if (width > FlatBoundaryIndex::maxExtent || height > FlatBoundaryIndex::maxExtent) {
+        // Integer distances would overflow, use the floating point tree instead
+        forEachNearestBoundaryOfLargeImage(image, width, holes, boundaryPixels, k, scratch, visit);
+        return;
+    }
+
+    // Small boundaries are scanned in full, which beats building and traversing a tree.
+    // A single leaf needs less memory than the tree, so it is also the fallback when the tree does not fit.
+    bool bruteForce = boundaryPixels.size() <= tuning().bruteForceSearchMaxBoundary;
+    std::optional<FlatBoundaryIndex> index;
+    try {
+        index.emplace(width, boundaryPixels, &scratch,
+                      bruteForce ? std::max<size_t>(boundaryPixels.size(), 1) : tuning().searchLeafSize);
+    } catch (const MemoryBudgetExceeded&) {
+        if (bruteForce) throw;
+        scratch.degrade();
+        bruteForce = true;
+        index.emplace(width, boundaryPixels, &scratch, std::max<size_t>(boundaryPixels.size(), 1));
+    }
+
+    NeighborHeaps<uint32_t> heaps(1, k, &scratch);
+    std::pmr::vector<std::pair<uint32_t, size_t>> neighbors(k, &scratch);
+
+    Coord previous;
+    uint32_t previousWorst = std::numeric_limits<uint32_t>::max();
+
+    scratch.enterPhase(FillPhase::Query);
+    holes.forEachPixel([&](const int32_t x, const int32_t y) {
+        scratch.checkCancelled();
+        const Coord u{x, y};
+        heaps.sizes[0] = 0;
+
+        if (bruteForce) {
+            // The k neighbors of the previous hole pixel are all within its k-th distance plus the
+            // step between the two pixels, so only boundary pixels inside that radius can qualify
+            uint32_t limit = std::numeric_limits<uint32_t>::max();
+            if (previousWorst != std::numeric_limits<uint32_t>::max()) {
+                const float step = std::hypot(static_cast<float>(u.x - previous.x), static_cast<float>(u.y - previous.y));
+                const float radius = std::sqrt(static_cast<float>(previousWorst)) + step + 1.0f;
+                if (radius * radius < static_cast<float>(std::numeric_limits<uint32_t>::max())) {
+                    limit = static_cast<uint32_t>(radius * radius);
+                }
+            }
+
+            const uint32_t count = static_cast<uint32_t>(index->xs.size());
+            index->scan(0, count, u.x, u.y, heaps, 0, limit);
+            if (heaps.sizes[0] < k) {
+                heaps.sizes[0] = 0;
+                index->scan(0, count, u.x, u.y, heaps, 0);
+            }
+
+            previous = u;
+            previousWorst = heaps.worst(0);
+        } else {
+            index->search(u.x, u.y, heaps, 0);
+        }
+
+        // Accumulate in order of increasing distance, equally distant neighbors in row-major order
+        const size_t found = heaps.sizes[0];
+        for (size_t i = 0; i < found; ++i) neighbors[i] = {heaps.distances[i], heaps.indices[i]};
+        std::sort(neighbors.begin(), neighbors.begin() + found);
+
+        // Boundary pixels are never written, so their values are read from the image
+        visit(u, found, [&](const size_t i) {
+            const size_t p = neighbors[i].second;
+            return std::pair<Coord, float>{Coord{static_cast<int32_t>(p % width), static_cast<int32_t>(p / width)}, image[p]};
+        });
+    });
+}
+
+void fillExactWithSearch(float* const image, const int32_t width, const int32_t height,
+                         const WeightFunction& weightFunc, const size_t nearestNeighborMax, ScratchResource& scratch) {
+    scratch.enterPhase(FillPhase::Detection);
+    const HoleSpans holes(image, width, height, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    const size_t k = std::min(nearestNeighborMax, boundaryPixels.size());  // Number of nearest neighbors
+
+    forEachNearestBoundary(image, width, height, holes, boundaryPixels, k, scratch,
+                           [&](const Coord& u, const size_t found, const auto& neighbor) {
         float numerator = 0.0f;
         float denominator = 0.0f;
 
-        for (size_t i = 0; i < k; ++i) {
-            if (indices[i] == std::numeric_limits<size_t>::max()) continue; // Skip invalid indices
-
-            const Coord& v = cloud.points[indices[i]];
+        for (size_t i = 0; i < found; ++i) {
+            const auto [v, intensity] = neighbor(i);
             const float w = weightFunc(u, v);
-            const float intensity = image[v.y * width + v.x];
             numerator += w * intensity;
             denominator += w;
         }
@@ -212,6 +1005,1061 @@ void fillExactWithSearch(float* const image, const int32_t width, const int32_t
         image[u.y * width + u.x] = (denominator > std::numeric_limits<float>::epsilon())
             ? numerator / denominator
             : 0.0f;  // Fallback value
+    });
+}
+
+void fillExactWithSearch(float* const image, const int32_t width, const int32_t height,
+                         const WeightFunction weightFunc, const size_t nearestNeighborMax, const FillOptions& options) {
+    ScratchResource scratch(options);
+    fillExactWithSearch(image, width, height, weightFunc, nearestNeighborMax, scratch);
+}
+
+void fillExactWithSearchSweep(const float* const image, const int32_t width, const int32_t height,
+                              const std::span<const SweepSetting> settings, const FillOptions& options) {
+    ScratchResource scratch(options);
+    if (settings.empty()) return;
+    copyToOutputs(image, width, height, settings);
+    const HoleSpans holes(image, width, height, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    // One search for the most neighbors any setting asks for, whose nearest ones serve the others
+    size_t k = 0;
+    for (const SweepSetting& setting : settings) {
+        k = std::max(k, std::min(setting.nearestNeighborMax, boundaryPixels.size()));
+    }
+    std::pmr::vector<WeightedSum> sums(settings.size(), &scratch);
+    const SweepWeights sweepWeights(settings, &scratch);
+    std::pmr::vector<float> logs(sweepWeights.epsilons.size(), &scratch);
+
+    forEachNearestBoundary(image, width, height, holes, boundaryPixels, k, scratch,
+                           [&](const Coord& u, const size_t found, const auto& neighbor) {
+        std::fill(sums.begin(), sums.end(), WeightedSum{});
+        for (size_t i = 0; i < found; ++i) {
+            const auto [v, intensity] = neighbor(i);
+            sweepWeights.logDistances(u, v, logs.data());
+            for (size_t t = 0; t < settings.size(); ++t) {
+                if (i >= settings[t].nearestNeighborMax) continue;
+                const float w = sweepWeights.weight(t, u, v, logs.data());
+                sums[t].numerator += w * intensity;
+                sums[t].denominator += w;
+            }
+        }
+
+        for (size_t t = 0; t < settings.size(); ++t) {
+            settings[t].output[static_cast<size_t>(u.y) * width + u.x] = averageOf(sums[t]);
+        }
+    });
+}
+
+// Quadtree part of fillAdaptive over the inclusive hole bounding box [minX, maxX] x [minY, maxY].
+// All scratch memory is allocated before the first pixel is written, so running out of budget
+// leaves the image untouched.
+void fillAdaptiveCells(float* const image, const int32_t width, const std::pmr::vector<Coord>& boundaryPixels,
+                       const WeightFunction& weightFunc, const float tolerance, const int32_t maxCellSize,
+                       const int32_t minX, const int32_t minY, const int32_t maxX, const int32_t maxY,
+                       const bool deterministic, ScratchResource& scratch) {
+    scratch.enterPhase(FillPhase::IndexBuild);
+    const int32_t boxWidth = maxX - minX + 1;
+    const int32_t boxHeight = maxY - minY + 1;
+
+    // Summed-area table of the hole mask, used to test whether a cell lies entirely inside a hole
+    std::pmr::vector<int32_t> holeSum(static_cast<size_t>(boxWidth + 1) * (boxHeight + 1), 0, &scratch);
+    for (int32_t y = minY; y <= maxY; ++y) {
+        for (int32_t x = minX; x <= maxX; ++x) {
+            if (getPixel(image, x, y, width) < 0.0f) {
+                holeSum[static_cast<size_t>(y - minY + 1) * (boxWidth + 1) + (x - minX + 1)] = 1;
+            }
+        }
+    }
+    for (int32_t y = 1; y <= boxHeight; ++y) {
+        for (int32_t x = 1; x <= boxWidth; ++x) {
+            const size_t i = static_cast<size_t>(y) * (boxWidth + 1) + x;
+            holeSum[i] += holeSum[i - 1] + holeSum[i - (boxWidth + 1)] - holeSum[i - (boxWidth + 1) - 1];
+        }
+    }
+    const auto holeCount = [&](const int32_t x0, const int32_t y0, const int32_t x1, const int32_t y1) {
+        const size_t stride = boxWidth + 1;
+        const size_t ax = x0 - minX, ay = y0 - minY, bx = x1 - minX + 1, by = y1 - minY + 1;
+        return holeSum[by * stride + bx] - holeSum[ay * stride + bx] - holeSum[by * stride + ax] + holeSum[ay * stride + ax];
+    };
+
+    // Exact values are cached so lattice points shared between cells are evaluated once
+    std::pmr::vector<float> exact(static_cast<size_t>(boxWidth) * boxHeight, -1.0f, &scratch);
+    const auto evaluate = [&](const int32_t x, const int32_t y) {
+        float& value = exact[static_cast<size_t>(y - minY) * boxWidth + (x - minX)];
+        if (value < 0.0f) {
+            value = weightedAverage(image, width, Coord{x, y}, boundaryPixels, weightFunc, deterministic);
+        }
+        return value;
+    };
+
+    // Nearest boundary distance decides whether a cell is far enough for the field to be smooth
+    const CoordCloud cloud{&boundaryPixels};
+    const size_t leafSize = tuning().floatTreeLeafSize;
+    const ScratchCharge treeCharge(scratch, nanoflannIndexBytes(boundaryPixels.size(), leafSize));
+    CoordKDTree tree(2, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(leafSize));
+    tree.buildIndex();
+
+    const auto boundaryDistance = [&](const float x, const float y) {
+        const float queryPt[2] = { x, y };
+        size_t index = 0;
+        float distanceSquared = std::numeric_limits<float>::max();
+        tree.knnSearch(queryPt, 1, &index, &distanceSquared);
+        return std::sqrt(distanceSquared);
+    };
+
+    int32_t rootSize = 2;
+    while (rootSize < maxCellSize) rootSize *= 2;
+
+    struct Cell {
+        int32_t x0;
+        int32_t y0;
+        int32_t size;
+    };
+    // Every popped cell pushes at most four children, so the stack never outgrows the roots plus
+    // three cells per level
+    int32_t levels = 0;
+    for (int32_t size = rootSize; size > 1; size /= 2) ++levels;
+    std::pmr::vector<Cell> cells(&scratch);
+    cells.reserve(static_cast<size_t>((boxWidth + rootSize - 1) / rootSize) * ((boxHeight + rootSize - 1) / rootSize) + 3 * levels);
+    for (int32_t y = minY; y <= maxY; y += rootSize) {
+        for (int32_t x = minX; x <= maxX; x += rootSize) {
+            cells.push_back({x, y, rootSize});
+        }
+    }
+
+    scratch.enterPhase(FillPhase::Query);
+    while (!cells.empty()) {
+        scratch.checkCancelled();
+        const Cell cell = cells.back();
+        cells.pop_back();
+
+        // Cells span [x0, x0 + size] so that neighbours share their edges
+        const int32_t x0 = cell.x0;
+        const int32_t y0 = cell.y0;
+        const int32_t x1 = std::min(cell.x0 + cell.size, maxX);
+        const int32_t y1 = std::min(cell.y0 + cell.size, maxY);
+        const int32_t area = (x1 - x0 + 1) * (y1 - y0 + 1);
+
+        const int32_t holes = holeCount(x0, y0, x1, y1);
+        if (holes == 0) continue;
+
+        bool interpolated = false;
+
+        if (holes == area && cell.size > 1) {
+            const float cx = 0.5f * (x0 + x1);
+            const float cy = 0.5f * (y0 + y1);
+            const float halfDiagonal = 0.5f * std::sqrt(static_cast<float>((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0)));
+
+            if (boundaryDistance(cx, cy) - halfDiagonal >= static_cast<float>(cell.size)) {
+                const float v00 = evaluate(x0, y0);
+                const float v10 = evaluate(x1, y0);
+                const float v01 = evaluate(x0, y1);
+                const float v11 = evaluate(x1, y1);
+
+                const auto bilinear = [&](const int32_t x, const int32_t y) {
+                    const float tx = (x1 > x0) ? static_cast<float>(x - x0) / (x1 - x0) : 0.0f;
+                    const float ty = (y1 > y0) ? static_cast<float>(y - y0) / (y1 - y0) : 0.0f;
+                    const float top = v00 + (v10 - v00) * tx;
+                    const float bottom = v01 + (v11 - v01) * tx;
+                    return top + (bottom - top) * ty;
+                };
+
+                // Probe the edge midpoints and the centre against the exact field
+                const int32_t mx = (x0 + x1) / 2;
+                const int32_t my = (y0 + y1) / 2;
+                const Coord probes[5] = { {mx, y0}, {mx, y1}, {x0, my}, {x1, my}, {mx, my} };
+
+                bool smooth = true;
+                for (const Coord& p : probes) {
+                    if (std::fabs(evaluate(p.x, p.y) - bilinear(p.x, p.y)) > tolerance) {
+                        smooth = false;
+                        break;
+                    }
+                }
+
+                if (smooth) {
+                    for (int32_t y = y0; y <= y1; ++y) {
+                        for (int32_t x = x0; x <= x1; ++x) {
+                            const float cached = exact[static_cast<size_t>(y - minY) * boxWidth + (x - minX)];
+                            image[y * width + x] = (cached >= 0.0f) ? cached : bilinear(x, y);
+                        }
+                    }
+                    interpolated = true;
+                }
+            }
+        }
+
+        if (interpolated) continue;
+
+        if (cell.size > 2) {
+            const int32_t half = cell.size / 2;
+            for (int32_t dy = 0; dy < 2; ++dy) {
+                for (int32_t dx = 0; dx < 2; ++dx) {
+                    const int32_t cx0 = cell.x0 + dx * half;
+                    const int32_t cy0 = cell.y0 + dy * half;
+                    if (cx0 <= maxX && cy0 <= maxY) {
+                        cells.push_back({cx0, cy0, half});
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Smallest cells near the boundary are evaluated per pixel
+        for (int32_t y = y0; y <= y1; ++y) {
+            for (int32_t x = x0; x <= x1; ++x) {
+                if (holeCount(x, y, x, y) != 0) {
+                    image[y * width + x] = evaluate(x, y);
+                }
+            }
+        }
+    }
+}
+
+void fillAdaptive(float* const image, const int32_t width, const int32_t height, const WeightFunction weightFunc,
+                  const float tolerance, const int32_t maxCellSize, const FillOptions& options) {
+    ScratchResource scratch(options);
+
+    const HoleSpans holes(image, width, height, &scratch);
+    if (holes.empty()) return;
+
+    // Bounding box of all hole pixels, inclusive
+    const int32_t minY = holes.spans.front().y;
+    const int32_t maxY = holes.spans.back().y;
+    int32_t minX = width, maxX = -1;
+    for (const HoleSpan& span : holes.spans) {
+        minX = std::min(minX, span.x0);
+        maxX = std::max(maxX, span.x1 - 1);
+    }
+
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    try {
+        fillAdaptiveCells(image, width, boundaryPixels, weightFunc, tolerance, maxCellSize, minX, minY, maxX, maxY,
+                          options.deterministic, scratch);
+    } catch (const MemoryBudgetExceeded&) {
+        // The lattice does not fit, evaluate every pixel instead
+        scratch.degrade();
+        fillFromBoundary(image, width, holes, boundaryPixels, weightFunc, options.deterministic, scratch);
+    }
+}
+
+// Distance from a boundary pixel beyond which moving it by factor pixels, as the coarse grid of
+// fillMultiresolution does, changes its weight by at most bandTolerance of the weight. For kernels
+// that never get that flat, limit.
+int32_t multiresolutionBandWidth(const WeightFunction& weightFunc, const int32_t factor, const float bandTolerance,
+                                 const int32_t limit) {
+    const Coord origin{0, 0};
+    for (int32_t distance = 1; distance < limit; ++distance) {
+        const float near = weightFunc(origin, Coord{distance, 0});
+        const float far = weightFunc(origin, Coord{distance + factor, 0});
+        if (near > 0.0f && std::fabs(near - far) <= bandTolerance * near) return distance;
+    }
+    return limit;
+}
+
+// Share of the hole pixels, as 1 / share, that must lie farther than band from the boundary for the
+// reduced fill to pay for itself
+constexpr size_t multiresolutionMinInteriorShare = 4;
+
+// Coarse part of fillMultiresolution: fills the hole pixels farther than band from the boundary from
+// the exact fill of the image reduced by factor, and the others exactly. Returns false, with the image
+// untouched, when too few hole pixels are that far. All scratch memory is allocated before the first pixel
+// is written, so running out of budget leaves the image untouched.
+bool fillMultiresolutionLevels(float* const image, const int32_t width, const int32_t height, const HoleSpans& holes,
+                               const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc,
+                               const int32_t factor, const int32_t band, const bool deterministic,
+                               ScratchResource& scratch) {
+    scratch.enterPhase(FillPhase::IndexBuild);
+
+    // Box of the holes and their neighbors, so that the mask sees valid pixels around the holes
+    int32_t holeX0 = width;
+    int32_t holeX1 = 0;
+    for (const HoleSpan& span : holes.spans) {
+        holeX0 = std::min(holeX0, span.x0);
+        holeX1 = std::max(holeX1, span.x1);
+    }
+    const int32_t holeY0 = holes.spans.front().y;
+    const int32_t holeY1 = holes.spans.back().y + 1;
+    const Coord origin{std::max(0, holeX0 - 1), std::max(0, holeY0 - 1)};
+    const int32_t boxWidth = std::min(width, holeX1 + 1) - origin.x;
+    const int32_t boxHeight = std::min(height, holeY1 + 1) - origin.y;
+
+    // Hole pixels farther than band from every valid pixel: eroding by a square keeps those whose
+    // (2 * band + 1) square is all holes. Outside the image counts as holes, as it is no boundary.
+    const size_t maskBytes = (static_cast<size_t>(boxWidth) + 63) / 64 * sizeof(uint64_t) * boxHeight;
+    const ScratchCharge maskCharge(scratch, 2 * maskBytes);
+    HoleMask interior(boxWidth, boxHeight);
+    for (const HoleSpan& span : holes.spans) {
+        uint64_t* const row = interior.row(span.y - origin.y);
+        for (int32_t x = span.x0 - origin.x; x < span.x1 - origin.x; ++x) row[x >> 6] |= uint64_t{1} << (x & 63);
+    }
+    interior.erode(band);
+    // Only the interior is cheaper than fill(); the mask, the grid and the reduced fill are paid for
+    // whatever its size. Below a quarter of the hole pixels they cost more than the interior saves.
+    if (interior.count() * multiresolutionMinInteriorShare < holes.pixelCount) return false;
+
+    // Grid of factor × factor blocks over the box, aligned to the image. A block whose pixels are all
+    // holes is a hole, any other holds the mean of its valid pixels.
+    const int32_t gridX0 = origin.x / factor;
+    const int32_t gridY0 = origin.y / factor;
+    const int32_t gridWidth = (origin.x + boxWidth - 1) / factor - gridX0 + 1;
+    const int32_t gridHeight = (origin.y + boxHeight - 1) / factor - gridY0 + 1;
+    std::pmr::vector<float> coarse(static_cast<size_t>(gridWidth) * gridHeight, &scratch);
+    parallelFor(static_cast<size_t>(gridHeight), [&](const size_t gy) {
+        const int32_t y0 = (gridY0 + static_cast<int32_t>(gy)) * factor;
+        const int32_t y1 = std::min(height, y0 + factor);
+        for (int32_t gx = 0; gx < gridWidth; ++gx) {
+            const int32_t x0 = (gridX0 + gx) * factor;
+            const int32_t x1 = std::min(width, x0 + factor);
+            float sum = 0.0f;
+            int32_t valid = 0;
+            for (int32_t y = y0; y < y1; ++y) {
+                for (int32_t x = x0; x < x1; ++x) {
+                    const float value = getPixel(image, x, y, width);
+                    if (value >= 0.0f) {
+                        sum += value;
+                        ++valid;
+                    }
+                }
+            }
+            coarse[gy * gridWidth + gx] = valid ? sum / static_cast<float>(valid) : -1.0f;
+        }
+    });
+
+    // Blocks the interior pixels interpolate from: their own and the eight around it
+    std::pmr::vector<uint8_t> needed(static_cast<size_t>(gridWidth) * gridHeight, 0, &scratch);
+    for (int32_t y = 0; y < boxHeight; ++y) {
+        const uint64_t* const row = interior.row(y);
+        const int32_t gy = (origin.y + y) / factor - gridY0;
+        for (size_t w = 0; w < interior.wordsPerRow(); ++w) {
+            for (uint64_t word = row[w]; word; word &= word - 1) {
+                const int32_t x = static_cast<int32_t>(w * 64) + std::countr_zero(word);
+                const int32_t gx = (origin.x + x) / factor - gridX0;
+                for (int32_t ny = std::max(0, gy - 1); ny <= std::min(gridHeight - 1, gy + 1); ++ny) {
+                    for (int32_t nx = std::max(0, gx - 1); nx <= std::min(gridWidth - 1, gx + 1); ++nx) {
+                        needed[static_cast<size_t>(ny) * gridWidth + nx] = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    const HoleSpans coarseHoles(coarse.data(), gridWidth, gridHeight, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> coarseBoundary = findBoundaryPixels(coarse.data(), gridWidth, gridHeight,
+                                                                      coarseHoles, &scratch);
+
+    // Weights of the grid are those of the block centres in the image, and a block of the boundary
+    // stands for the factor boundary pixels along its edge, so the sums of weights match those of the
+    // image where fill() falls back to zero
+    const float blockWeight = static_cast<float>(factor);
+    const WeightFunction coarseWeight = [&](const Coord& u, const Coord& v) {
+        return blockWeight * weightFunc(Coord{(gridX0 + u.x) * factor + factor / 2, (gridY0 + u.y) * factor + factor / 2},
+                                        Coord{(gridX0 + v.x) * factor + factor / 2, (gridY0 + v.y) * factor + factor / 2});
+    };
+
+    scratch.enterPhase(FillPhase::Query);
+    parallelFor(coarseHoles.spans.size(), [&](const size_t s) {
+        scratch.checkCancelled();
+        const HoleSpan& span = coarseHoles.spans[s];
+        for (int32_t x = span.x0; x < span.x1; ++x) {
+            const size_t i = static_cast<size_t>(span.y) * gridWidth + x;
+            if (needed[i]) {
+                coarse[i] = weightedAverage(coarse.data(), gridWidth, Coord{x, span.y}, coarseBoundary, coarseWeight,
+                                            deterministic);
+            }
+        }
+    });
+
+    // Bilinear between the block centres, with the grid coordinate of a pixel centre (x + 0.5) / factor - 0.5
+    const auto upsample = [&](const int32_t x, const int32_t y) {
+        const float gx = std::max(0.0f, (static_cast<float>(x) + 0.5f) / factor - 0.5f - gridX0);
+        const float gy = std::max(0.0f, (static_cast<float>(y) + 0.5f) / factor - 0.5f - gridY0);
+        const int32_t x0 = std::min(static_cast<int32_t>(gx), gridWidth - 1);
+        const int32_t y0 = std::min(static_cast<int32_t>(gy), gridHeight - 1);
+        const int32_t x1 = std::min(x0 + 1, gridWidth - 1);
+        const int32_t y1 = std::min(y0 + 1, gridHeight - 1);
+        const float tx = std::min(1.0f, gx - static_cast<float>(x0));
+        const float ty = std::min(1.0f, gy - static_cast<float>(y0));
+        const float top = coarse[static_cast<size_t>(y0) * gridWidth + x0] * (1.0f - tx)
+                        + coarse[static_cast<size_t>(y0) * gridWidth + x1] * tx;
+        const float bottom = coarse[static_cast<size_t>(y1) * gridWidth + x0] * (1.0f - tx)
+                           + coarse[static_cast<size_t>(y1) * gridWidth + x1] * tx;
+        return top * (1.0f - ty) + bottom * ty;
+    };
+
+    // Exact sums read boundary pixels only, so filled pixels do not disturb them
+    parallelFor(holes.spans.size(), [&](const size_t s) {
+        scratch.checkCancelled();
+        const HoleSpan& span = holes.spans[s];
+        for (int32_t x = span.x0; x < span.x1; ++x) {
+            image[span.y * width + x] = interior.hole(x - origin.x, span.y - origin.y)
+                ? upsample(x, span.y)
+                : weightedAverage(image, width, Coord{x, span.y}, boundaryPixels, weightFunc, deterministic);
+        }
+    });
+    return true;
+}
+
+void fillMultiresolution(float* const image, const int32_t width, const int32_t height, const WeightFunction weightFunc,
+                         const int32_t factor, const float bandTolerance, const FillOptions& options) {
+    ScratchResource scratch(options);
+    const HoleSpans holes(image, width, height, &scratch);
+    if (holes.empty()) return;
+
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    if (factor > 1) {
+        const int32_t band = multiresolutionBandWidth(weightFunc, factor, bandTolerance, std::max(width, height));
+        try {
+            if (fillMultiresolutionLevels(image, width, height, holes, boundaryPixels, weightFunc, factor, band,
+                                          options.deterministic, scratch)) {
+                return;
+            }
+        } catch (const MemoryBudgetExceeded&) {
+            // The mask or the grid does not fit, evaluate every pixel instead
+            scratch.degrade();
+        }
+    }
+    fillFromBoundary(image, width, holes, boundaryPixels, weightFunc, options.deterministic, scratch);
+}
+
+// Bilinear interpolation is least accurate at the centres of the lattice cells, where the checks lie,
+// but the exact result can still bend more between them, so the largest difference found at the checks
+// of a tile is taken this many times over
+constexpr float hybridErrorMargin = 2.0f;
+
+// Sums of weights within this factor of the threshold of averageOf may vanish on either side of it
+// between two lattice points, so those pixels are evaluated exactly
+constexpr float hybridVanishingMargin = 2.0f;
+
+// Tile of fillHybrid
+struct HybridTile {
+    uint32_t holePixels = 0;
+    // Hole pixels interpolated or set to zero, not evaluated exactly, unless the tile is refined
+    uint32_t estimatedPixels = 0;
+    // Largest difference between the estimate and the exact fill at the checks
+    float error = 0.0f;
+};
+
+// How fillHybrid fills a pixel outside the refined tiles
+enum class HybridEstimate : uint8_t {
+    Exact,         ///< Evaluated as in fill()
+    Interpolated,  ///< Bilinear interpolation of the lattice
+    Vanished       ///< Zero, as fill() gives where the weights vanish
+};
+
+HybridFillReport fillHybrid(float* const image, const int32_t width, const int32_t height,
+                            const WeightFunction weightFunc, const float tolerance, int32_t tileSize,
+                            const FillOptions& options) {
+    ScratchResource scratch(options);
+    HybridFillReport report;
+    const HoleSpans holes(image, width, height, &scratch);
+    if (holes.empty()) return report;
+    report.holePixels = holes.pixelCount;
+
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    // Lattice points every stride pixels, at stride / 2 + i * stride in each direction, over the holes
+    // and a lattice point beyond them on every side, so that every hole pixel has the 4 × 4 around it.
+    // Tiles over the rows and columns of the holes, aligned to the image.
+    tileSize = std::max(1, tileSize);
+    const int32_t stride = std::max(1, tileSize / 4);
+    const auto latticeIndex = [&](const int32_t x) {
+        const int32_t offset = x - stride / 2;
+        return (offset >= 0) ? offset / stride : -((stride - 1 - offset) / stride);
+    };
+    int32_t holeX0 = width;
+    int32_t holeX1 = 0;
+    for (const HoleSpan& span : holes.spans) {
+        holeX0 = std::min(holeX0, span.x0);
+        holeX1 = std::max(holeX1, span.x1);
+    }
+    const int32_t latticeX0 = latticeIndex(holeX0) - 1;
+    const int32_t latticeY0 = latticeIndex(holes.spans.front().y) - 1;
+    const int32_t latticeWidth = latticeIndex(holeX1 - 1) + 3 - latticeX0;
+    const int32_t latticeHeight = latticeIndex(holes.spans.back().y) + 3 - latticeY0;
+    const int32_t tileX0 = holeX0 / tileSize;
+    const int32_t tileY0 = holes.spans.front().y / tileSize;
+    const int32_t tilesX = (holeX1 - 1) / tileSize - tileX0 + 1;
+    const int32_t tilesY = holes.spans.back().y / tileSize - tileY0 + 1;
+    const auto tileOf = [&](const int32_t x, const int32_t y) {
+        return static_cast<size_t>(y / tileSize - tileY0) * tilesX + (x / tileSize - tileX0);
+    };
+    const auto onLattice = [&](const int32_t x) { return (x + stride - stride / 2) % stride == 0; };
+    const auto isCheck = [&](const int32_t x) { return (x + stride - stride / 2) % stride == stride / 2; };
+
+    // Average and log of the sum of weights at each lattice point, the average negative outside the holes
+    std::pmr::vector<float> latticeValues(&scratch);
+    std::pmr::vector<float> latticeLogWeights(&scratch);
+    std::pmr::vector<HybridTile> tiles(&scratch);
+    std::pmr::vector<Coord> checks(&scratch);
+    std::pmr::vector<float> estimates(&scratch);
+    std::pmr::vector<float> exact(&scratch);
+    std::pmr::vector<uint8_t> refine(&scratch);
+    try {
+        latticeValues.assign(static_cast<size_t>(latticeWidth) * latticeHeight, -1.0f);
+        latticeLogWeights.resize(latticeValues.size());
+        tiles.resize(static_cast<size_t>(tilesX) * tilesY);
+        refine.resize(tiles.size());
+    } catch (const MemoryBudgetExceeded&) {
+        // No room for the lattice: evaluate every pixel instead
+        scratch.degrade();
+        fillFromBoundary(image, width, holes, boundaryPixels, weightFunc, options.deterministic, scratch);
+        report.refinedPixels = report.holePixels;
+        return report;
+    }
+
+    // Exact sums read boundary pixels only, so the holes may be written while they are evaluated
+    scratch.enterPhase(FillPhase::Query);
+    parallelFor(static_cast<size_t>(latticeHeight), [&](const size_t row) {
+        scratch.checkCancelled();
+        const int32_t y = (latticeY0 + static_cast<int32_t>(row)) * stride + stride / 2;
+        if (y < 0 || y >= height) return;
+        for (int32_t column = 0; column < latticeWidth; ++column) {
+            const int32_t x = (latticeX0 + column) * stride + stride / 2;
+            if (x < 0 || x >= width || !(getPixel(image, x, y, width) < 0.0f)) continue;
+            const WeightedSum sum = boundarySum(image, width, Coord{x, y}, boundaryPixels, weightFunc,
+                                                options.deterministic);
+            const size_t i = row * latticeWidth + column;
+            latticeValues[i] = averageOf(sum);
+            latticeLogWeights[i] = std::log(std::max(sum.denominator, std::numeric_limits<float>::min()));
+        }
+    });
+    for (const float value : latticeValues) report.samples += value >= 0.0f;
+
+    // Interpolates where the 4 × 4 lattice points around the pixel are all in the holes, so that none
+    // is within a lattice cell of the boundary, where the kernel is sharp. Where the weights vanish at
+    // all four corners the pixel is zero as in fill(), where they vanish at some, or the interpolated
+    // sum of weights is near the threshold, it is evaluated exactly.
+    const float logThreshold = std::log(std::numeric_limits<float>::epsilon());
+    const float logMargin = std::log(hybridVanishingMargin);
+    const auto estimate = [&](const int32_t x, const int32_t y, float& value) {
+        const int32_t gx = latticeIndex(x) - latticeX0;
+        const int32_t gy = latticeIndex(y) - latticeY0;
+        for (int32_t ny = gy - 1; ny <= gy + 2; ++ny) {
+            for (int32_t nx = gx - 1; nx <= gx + 2; ++nx) {
+                if (latticeValues[static_cast<size_t>(ny) * latticeWidth + nx] < 0.0f) return HybridEstimate::Exact;
+            }
+        }
+        const float fx = static_cast<float>(x - (latticeX0 + gx) * stride - stride / 2) / static_cast<float>(stride);
+        const float fy = static_cast<float>(y - (latticeY0 + gy) * stride - stride / 2) / static_cast<float>(stride);
+        float interpolated = 0.0f;
+        float logWeight = 0.0f;
+        int vanished = 0;
+        for (int32_t corner = 0; corner < 4; ++corner) {
+            const int32_t dx = corner & 1;
+            const int32_t dy = corner >> 1;
+            const float w = (dx ? fx : 1.0f - fx) * (dy ? fy : 1.0f - fy);
+            const size_t i = static_cast<size_t>(gy + dy) * latticeWidth + gx + dx;
+            interpolated += w * latticeValues[i];
+            logWeight += w * latticeLogWeights[i];
+            vanished += latticeLogWeights[i] <= logThreshold;
+        }
+        if (vanished == 4 && logWeight <= logThreshold - logMargin) {
+            value = 0.0f;
+            return HybridEstimate::Vanished;
+        }
+        if (vanished == 0 && logWeight > logThreshold + logMargin) {
+            value = interpolated;
+            return HybridEstimate::Interpolated;
+        }
+        return HybridEstimate::Exact;
+    };
+
+    // Checks at the centres of the lattice cells whose pixels are estimated, their estimates kept until
+    // the exact values are known
+    try {
+        for (const HoleSpan& span : holes.spans) {
+            const bool checkRow = isCheck(span.y);
+            for (int32_t x = span.x0; x < span.x1; ++x) {
+                HybridTile& tile = tiles[tileOf(x, span.y)];
+                ++tile.holePixels;
+                float value;
+                if ((onLattice(x) && onLattice(span.y)) || estimate(x, span.y, value) == HybridEstimate::Exact) continue;
+                if (checkRow && isCheck(x)) {
+                    checks.push_back(Coord{x, span.y});
+                    estimates.push_back(value);
+                } else {
+                    ++tile.estimatedPixels;
+                }
+            }
+        }
+        exact.resize(checks.size());
+    } catch (const MemoryBudgetExceeded&) {
+        // No room for the checks: evaluate every pixel instead
+        scratch.degrade();
+        fillFromBoundary(image, width, holes, boundaryPixels, weightFunc, options.deterministic, scratch);
+        report.refinedPixels = report.holePixels;
+        return report;
+    }
+
+    parallelFor(checks.size(), [&](const size_t i) {
+        scratch.checkCancelled();
+        exact[i] = weightedAverage(image, width, checks[i], boundaryPixels, weightFunc, options.deterministic);
+    });
+    for (size_t i = 0; i < checks.size(); ++i) {
+        image[static_cast<size_t>(checks[i].y) * width + checks[i].x] = exact[i];
+        HybridTile& tile = tiles[tileOf(checks[i].x, checks[i].y)];
+        tile.error = std::max(tile.error, std::abs(exact[i] - estimates[i]));
+    }
+    report.samples += checks.size();
+
+    report.refinedPixels = report.holePixels;
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        if (!tiles[t].holePixels) continue;
+        ++report.tiles;
+        if (hybridErrorMargin * tiles[t].error > tolerance) {
+            refine[t] = 1;
+            ++report.refinedTiles;
+        } else {
+            report.refinedPixels -= tiles[t].estimatedPixels;
+        }
+    }
+
+    parallelFor(holes.spans.size(), [&](const size_t s) {
+        scratch.checkCancelled();
+        const HoleSpan& span = holes.spans[s];
+        const bool latticeRow = onLattice(span.y);
+        const bool checkRow = isCheck(span.y);
+        for (int32_t x = span.x0; x < span.x1; ++x) {
+            float& pixel = image[span.y * width + x];
+            if (latticeRow && onLattice(x)) {
+                pixel = latticeValues[static_cast<size_t>(latticeIndex(span.y) - latticeY0) * latticeWidth +
+                                      (latticeIndex(x) - latticeX0)];
+                continue;
+            }
+            // Checks already hold their exact value
+            if (checkRow && isCheck(x) && pixel >= 0.0f) continue;
+            float value;
+            if (!refine[tileOf(x, span.y)] && estimate(x, span.y, value) != HybridEstimate::Exact) {
+                pixel = value;
+            } else {
+                pixel = weightedAverage(image, width, Coord{x, span.y}, boundaryPixels, weightFunc,
+                                        options.deterministic);
+            }
+        }
+    });
+    return report;
+}
+
+// SplitMix64, cheap to seed per pixel
+struct SplitMix64 {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+// Sampling part of fillStochastic. All scratch memory is allocated before the first pixel is
+// written, so running out of budget leaves the image untouched.
+void fillStochasticGrid(float* const image, const int32_t width, const int32_t height, const HoleSpans& holes,
+                        const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc,
+                        const size_t samplesPerPixel, float* const variance, const uint64_t seed,
+                        ScratchResource& scratch) {
+    scratch.enterPhase(FillPhase::IndexBuild);
+
+    // Grow the grid until the number of occupied cells is small enough to bound per pixel
+    constexpr size_t maxOccupiedCells = 1024;
+    int32_t cellSize = 8;
+    std::pmr::vector<int64_t> keys(boundaryPixels.size(), &scratch);
+    for (;;) {
+        for (size_t i = 0; i < boundaryPixels.size(); ++i) {
+            const Coord& v = boundaryPixels[i];
+            keys[i] = static_cast<int64_t>(v.y / cellSize) * width + (v.x / cellSize);
+        }
+        std::pmr::vector<int64_t> unique(keys, &scratch);
+        std::sort(unique.begin(), unique.end());
+        const size_t occupied = std::unique(unique.begin(), unique.end()) - unique.begin();
+        if (occupied <= maxOccupiedCells || cellSize >= std::max(width, height)) break;
+        cellSize *= 2;
+    }
+
+    // Boundary pixels sorted by cell so that every cell is a contiguous range
+    std::pmr::vector<size_t> order(boundaryPixels.size(), &scratch);
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return keys[a] < keys[b]; });
+
+    std::pmr::vector<Coord> points(boundaryPixels.size(), &scratch);
+    std::pmr::vector<float> intensities(boundaryPixels.size(), &scratch);
+    for (size_t i = 0; i < order.size(); ++i) {
+        points[i] = boundaryPixels[order[i]];
+        intensities[i] = getPixel(image, points[i].x, points[i].y, width);
+    }
+
+    struct Cell {
+        Coord min;
+        Coord max;
+        size_t begin;
+        size_t count;
+    };
+    std::pmr::vector<Cell> cells(&scratch);
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 || keys[order[i]] != keys[order[i - 1]]) {
+            cells.push_back({points[i], points[i], i, 0});
+        }
+        Cell& cell = cells.back();
+        cell.min = {std::min(cell.min.x, points[i].x), std::min(cell.min.y, points[i].y)};
+        cell.max = {std::max(cell.max.x, points[i].x), std::max(cell.max.y, points[i].y)};
+        ++cell.count;
+    }
+
+    std::pmr::vector<double> cumulative(cells.size(), &scratch);
+    std::pmr::vector<size_t> farCells(cells.size(), &scratch);
+    std::pmr::vector<double> samples(&scratch);
+    samples.reserve(samplesPerPixel * 2);
+
+    scratch.enterPhase(FillPhase::Query);
+    holes.forEachPixel([&](const int32_t x, const int32_t y) {
+        scratch.checkCancelled();
+        const Coord u{x, y};
+        double exactNumerator = 0.0;
+        double exactDenominator = 0.0;
+
+        // Bound each cell by the weight at its closest point; adjacent cells are summed exactly
+        double total = 0.0;
+        size_t farCount = 0;
+        for (size_t c = 0; c < cells.size(); ++c) {
+            const Cell& cell = cells[c];
+            const Coord closest{std::clamp(u.x, cell.min.x, cell.max.x), std::clamp(u.y, cell.min.y, cell.max.y)};
+
+            if (std::abs(closest.x - u.x) < cellSize && std::abs(closest.y - u.y) < cellSize) {
+                for (size_t i = cell.begin; i < cell.begin + cell.count; ++i) {
+                    const float w = weightFunc(u, points[i]);
+                    exactNumerator += w * intensities[i];
+                    exactDenominator += w;
+                }
+                continue;
+            }
+
+            total += static_cast<double>(weightFunc(u, closest)) * cell.count;
+            cumulative[farCount] = total;
+            farCells[farCount] = c;
+            ++farCount;
+        }
+
+        double numerator = exactNumerator;
+        double denominator = exactDenominator;
+        samples.clear();
+
+        if (farCount > 0 && total > 0.0 && samplesPerPixel > 0) {
+            SplitMix64 rng{seed ^ (static_cast<uint64_t>(u.y) * width + u.x) * 0xD1B54A32D192ED03ull};
+
+            double sampledNumerator = 0.0;
+            double sampledDenominator = 0.0;
+            for (size_t s = 0; s < samplesPerPixel; ++s) {
+                const double target = rng.uniform() * total;
+                const size_t slot = std::min<size_t>(
+                    std::upper_bound(cumulative.begin(), cumulative.begin() + farCount, target) - cumulative.begin(),
+                    farCount - 1);
+                const Cell& cell = cells[farCells[slot]];
+                const size_t i = cell.begin + std::min<size_t>(static_cast<size_t>(rng.uniform() * cell.count), cell.count - 1);
+
+                const double bound = cumulative[slot] - (slot > 0 ? cumulative[slot - 1] : 0.0);
+                const double probability = bound / total / cell.count;
+                const double w = weightFunc(u, points[i]) / probability;
+
+                sampledNumerator += w * intensities[i];
+                sampledDenominator += w;
+                samples.push_back(w);
+                samples.push_back(intensities[i]);
+            }
+
+            numerator += sampledNumerator / samplesPerPixel;
+            denominator += sampledDenominator / samplesPerPixel;
+        }
+
+        const bool valid = denominator > std::numeric_limits<float>::epsilon();
+        const double value = valid ? numerator / denominator : 0.0;
+        image[u.y * width + u.x] = static_cast<float>(value);
+
+        if (variance) {
+            // Delta-method variance of the ratio estimator
+            double spread = 0.0;
+            const size_t n = samples.size() / 2;
+            if (valid && n > 1) {
+                double mean = 0.0;
+                for (size_t s = 0; s < n; ++s) mean += samples[2 * s] * (samples[2 * s + 1] - value);
+                mean /= n;
+                for (size_t s = 0; s < n; ++s) {
+                    const double d = samples[2 * s] * (samples[2 * s + 1] - value) - mean;
+                    spread += d * d;
+                }
+                spread /= static_cast<double>(n - 1) * n * denominator * denominator;
+            }
+            variance[u.y * width + u.x] = static_cast<float>(spread);
+        }
+    });
+}
+
+void fillStochastic(float* const image, const int32_t width, const int32_t height,
+                    const WeightFunction weightFunc, const size_t samplesPerPixel,
+                    float* const variance, const uint64_t seed, const FillOptions& options) {
+    ScratchResource scratch(options);
+    const HoleSpans holes(image, width, height, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+
+    try {
+        fillStochasticGrid(image, width, height, holes, boundaryPixels, weightFunc, samplesPerPixel, variance, seed, scratch);
+    } catch (const MemoryBudgetExceeded&) {
+        // The grid does not fit, sum every boundary pixel exactly instead
+        scratch.degrade();
+        if (variance) {
+            holes.forEachPixel([&](const int32_t x, const int32_t y) { variance[y * width + x] = 0.0f; });
+        }
+        fillFromBoundary(image, width, holes, boundaryPixels, weightFunc, options.deterministic, scratch);
+    }
+}
+
+// KD-tree over pixel coordinates with an explicit bounding box per node
+struct CoordTree {
+    struct Node {
+        Coord min;
+        Coord max;
+        size_t begin;
+        size_t end;
+        size_t left;   // 0 for leaves
+        size_t right;
+    };
+
+    size_t leafSize;
+
+    std::pmr::vector<Coord> points;     // Reordered so every node is a contiguous range
+    std::pmr::vector<size_t> indices;   // Original index of each reordered point
+    std::pmr::vector<Node> nodes;
+
+    // Buffers for reordering a node's range, shared by all levels of the construction
+    struct BuildBuffers {
+        std::pmr::vector<size_t> order;
+        std::pmr::vector<Coord> sortedPoints;
+        std::pmr::vector<size_t> sortedIndices;
+    };
+
+    CoordTree(const std::pmr::vector<Coord>& input, std::pmr::memory_resource* const resource)
+        : leafSize(tuning().dualTreeLeafSize), points(input, resource), indices(input.size(), resource), nodes(resource) {
+        for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+        if (points.empty()) return;
+
+        nodes.reserve(4 * (points.size() / leafSize) + 1);
+        BuildBuffers buffers{std::pmr::vector<size_t>(points.size(), resource),
+                             std::pmr::vector<Coord>(points.size(), resource),
+                             std::pmr::vector<size_t>(points.size(), resource)};
+        build(0, points.size(), buffers);
+    }
+
+    size_t build(const size_t begin, const size_t end, BuildBuffers& buffers) {
+        Node node{points[begin], points[begin], begin, end, 0, 0};
+        for (size_t i = begin; i < end; ++i) {
+            node.min = {std::min(node.min.x, points[i].x), std::min(node.min.y, points[i].y)};
+            node.max = {std::max(node.max.x, points[i].x), std::max(node.max.y, points[i].y)};
+        }
+
+        const size_t id = nodes.size();
+        nodes.push_back(node);
+
+        if (end - begin > leafSize) {
+            // Split the wider dimension at the median
+            const bool splitX = (node.max.x - node.min.x) >= (node.max.y - node.min.y);
+            const size_t middle = begin + (end - begin) / 2;
+
+            const size_t count = end - begin;
+            size_t* const order = buffers.order.data();
+            for (size_t i = 0; i < count; ++i) order[i] = begin + i;
+            std::nth_element(order, order + (middle - begin), order + count, [&](const size_t a, const size_t b) {
+                return splitX ? points[a].x < points[b].x : points[a].y < points[b].y;
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                buffers.sortedPoints[i] = points[order[i]];
+                buffers.sortedIndices[i] = indices[order[i]];
+            }
+            std::copy(buffers.sortedPoints.begin(), buffers.sortedPoints.begin() + count, points.begin() + begin);
+            std::copy(buffers.sortedIndices.begin(), buffers.sortedIndices.begin() + count, indices.begin() + begin);
+
+            const size_t left = build(begin, middle, buffers);
+            const size_t right = build(middle, end, buffers);
+            nodes[id].left = left;
+            nodes[id].right = right;
+        }
+
+        return id;
+    }
+
+    bool isLeaf(const size_t id) const { return nodes[id].left == 0; }
+};
+
+// Squared distance between two bounding boxes, exact in 32 bits within FlatBoundaryIndex::maxExtent
+inline uint32_t boxDistanceSquared(const CoordTree::Node& a, const CoordTree::Node& b) {
+    const uint32_t dx = static_cast<uint32_t>(std::max({0, a.min.x - b.max.x, b.min.x - a.max.x}));
+    const uint32_t dy = static_cast<uint32_t>(std::max({0, a.min.y - b.max.y, b.min.y - a.max.y}));
+    return dx * dx + dy * dy;
+}
+
+// Neighbors are kept by integer distance and pixel index as in FlatBoundaryIndex, so the result
+// matches fillExactWithSearch and does not depend on how the traversal is split
+struct DualTreeSearch {
+    const CoordTree& queries;
+    const CoordTree& references;
+    size_t width;
+    NeighborHeaps<uint32_t>& heaps;
+    std::pmr::vector<uint32_t>& nodeBounds;  // Worst k-th distance of any query below each query node
+
+    void baseCase(const CoordTree::Node& q, const CoordTree::Node& r, const size_t queryNode) {
+        uint32_t bound = 0;
+        for (size_t i = q.begin; i < q.end; ++i) {
+            const Coord& u = queries.points[i];
+            for (size_t j = r.begin; j < r.end; ++j) {
+                const Coord& v = references.points[j];
+                const uint32_t dx = static_cast<uint32_t>(std::abs(u.x - v.x));
+                const uint32_t dy = static_cast<uint32_t>(std::abs(u.y - v.y));
+                heaps.push(i, dx * dx + dy * dy, static_cast<size_t>(v.y) * width + static_cast<size_t>(v.x));
+            }
+            bound = std::max(bound, heaps.worst(i));
+        }
+        nodeBounds[queryNode] = bound;
+    }
+
+    void traverse(const size_t queryNode, const size_t referenceNode) {
+        const CoordTree::Node& q = queries.nodes[queryNode];
+        const CoordTree::Node& r = references.nodes[referenceNode];
+
+        if (boxDistanceSquared(q, r) > nodeBounds[queryNode]) return;
+
+        const bool queryLeaf = queries.isLeaf(queryNode);
+        const bool referenceLeaf = references.isLeaf(referenceNode);
+
+        if (queryLeaf && referenceLeaf) {
+            baseCase(q, r, queryNode);
+            return;
+        }
+
+        // Descend the reference tree when the query node is a leaf or the smaller of the two
+        if (queryLeaf || (!referenceLeaf && (r.end - r.begin) > (q.end - q.begin))) {
+            size_t near = r.left;
+            size_t far = r.right;
+            if (boxDistanceSquared(q, references.nodes[far]) < boxDistanceSquared(q, references.nodes[near])) {
+                std::swap(near, far);
+            }
+            traverse(queryNode, near);
+            traverse(queryNode, far);
+            return;
+        }
+
+        traverse(q.left, referenceNode);
+        traverse(q.right, referenceNode);
+        nodeBounds[queryNode] = std::max(nodeBounds[q.left], nodeBounds[q.right]);
+    }
+};
+
+void fillExactWithDualTreeSearch(float* const image, const int32_t width, const int32_t height,
+                                 const WeightFunction weightFunc, const size_t nearestNeighborMax,
+                                 const FillOptions& options) {
+    ScratchResource scratch(options);
+
+    if (width > FlatBoundaryIndex::maxExtent || height > FlatBoundaryIndex::maxExtent) {
+        // Integer distances would overflow, and the single-tree search has a floating point path
+        fillExactWithSearch(image, width, height, weightFunc, nearestNeighborMax, scratch);
+        return;
+    }
+
+    try {
+        const HoleSpans holes(image, width, height, &scratch);
+        const std::pmr::vector<Coord> holePixels = findHolePixels(holes, &scratch);
+        scratch.enterPhase(FillPhase::Boundary);
+        const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes, &scratch);
+        if (holePixels.empty()) return;
+
+        const size_t k = std::min(nearestNeighborMax, boundaryPixels.size());
+        if (k == 0) {
+            for (const Coord& u : holePixels) image[u.y * width + u.x] = 0.0f;  // Fallback value
+            return;
+        }
+
+        scratch.enterPhase(FillPhase::IndexBuild);
+        const CoordTree holeTree(holePixels, &scratch);
+        const CoordTree boundaryTree(boundaryPixels, &scratch);
+
+        NeighborHeaps<uint32_t> heaps(holePixels.size(), k, &scratch);
+        std::pmr::vector<uint32_t> nodeBounds(holeTree.nodes.size(), std::numeric_limits<uint32_t>::max(), &scratch);
+
+        // Cut the hole tree into enough independent subtrees to keep every thread busy
+        const size_t targetSubtrees = 8 * std::max(1u, std::thread::hardware_concurrency());
+        std::pmr::vector<size_t> subtrees(1, 0, &scratch);
+        for (bool split = true; split && subtrees.size() < targetSubtrees;) {
+            split = false;
+            std::pmr::vector<size_t> next(&scratch);
+            for (const size_t id : subtrees) {
+                if (holeTree.isLeaf(id)) {
+                    next.push_back(id);
+                } else {
+                    next.push_back(holeTree.nodes[id].left);
+                    next.push_back(holeTree.nodes[id].right);
+                    split = true;
+                }
+            }
+            subtrees.swap(next);
+        }
+
+        // One neighbor buffer per subtree, allocated up front so that the traversal cannot run out of budget
+        std::pmr::vector<std::pair<uint32_t, size_t>> neighbors(subtrees.size() * k, &scratch);
+
+        // Neighbors of all subtrees are found before any pixel is written, so that the search and
+        // the weighted averages show up as separate phases. The heaps of all hole pixels are held anyway.
+        scratch.enterPhase(FillPhase::Query);
+        parallelFor(subtrees.size(), [&](const size_t s) {
+            scratch.checkCancelled();
+            DualTreeSearch search{holeTree, boundaryTree, static_cast<size_t>(width), heaps, nodeBounds};
+            search.traverse(subtrees[s], 0);
+        });
+
+        scratch.enterPhase(FillPhase::WriteBack);
+        parallelFor(subtrees.size(), [&](const size_t s) {
+            scratch.checkCancelled();
+            const CoordTree::Node& node = holeTree.nodes[subtrees[s]];
+            const auto sorted = neighbors.begin() + s * k;
+
+            for (size_t q = node.begin; q < node.end; ++q) {
+                for (size_t i = 0; i < k; ++i) {
+                    sorted[i] = {heaps.distances[q * k + i], heaps.indices[q * k + i]};
+                }
+                std::sort(sorted, sorted + k);
+
+                const Coord& u = holeTree.points[q];
+                float numerator = 0.0f;
+                float denominator = 0.0f;
+
+                for (size_t i = 0; i < k; ++i) {
+                    const size_t p = sorted[i].second;
+                    const float w = weightFunc(u, Coord{static_cast<int32_t>(p % width), static_cast<int32_t>(p / width)});
+                    numerator += w * image[p];
+                    denominator += w;
+                }
+
+                image[u.y * width + u.x] = (denominator > std::numeric_limits<float>::epsilon())
+                    ? numerator / denominator
+                    : 0.0f;  // Fallback value
+            }
+        });
+    } catch (const MemoryBudgetExceeded&) {
+        // The neighbor lists of all hole pixels do not fit, answer the queries one at a time
+        scratch.degrade();
+        fillExactWithSearch(image, width, height, weightFunc, nearestNeighborMax, scratch);
     }
 }
 
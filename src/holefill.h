@@ -1,8 +1,17 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <cmath>
+#include <new>
+#include <optional>
+#include <span>
+#include <memory_resource>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
 
 namespace holefill {
 
@@ -17,6 +26,211 @@ struct Coord {
 
 using WeightFunction = std::function<float(const Coord&, const Coord&)>;
 
+/**
+ * @brief Machine-dependent parameters of the fill engines.
+ *
+ * The defaults were measured with holefill_bench on a typical desktop machine. holefill_tune measures
+ * them on the machine it runs on and writes them to a file, which tuning() reads on first use; see
+ * defaultTuningPath(). They can be changed at runtime through tuning() before calling any fill function.
+ *
+ * k-nearest-neighbor searches keep the equally distant neighbors that come first in row-major order,
+ * whatever the leaf sizes. Chunk sizes that fix the order of floating point sums are not tunable, so
+ * deterministic fills do not depend on the tuning.
+ */
+struct Tuning {
+    /// Boundary size up to which fillExactWithSearch scans all boundary pixels instead of building a KD-tree
+    size_t bruteForceSearchMaxBoundary = 256;
+    /// Largest number of boundary pixels in a leaf of the KD-tree of fillExactWithSearch
+    size_t searchLeafSize = 16;
+    /// Largest number of pixels in a leaf of the hole and boundary trees of fillExactWithDualTreeSearch
+    size_t dualTreeLeafSize = 16;
+    /// Leaf size of the floating point KD-trees: the nearest boundary pixel search of fillAdaptive, the
+    /// k-nearest-neighbor search of fillExactWithSearch for images wider or taller than 46340 pixels
+    /// and that of fillExactWithSearch3D
+    size_t floatTreeLeafSize = 10;
+    /// Width of the box around the holes from which fillApproximate fills a copy of the box in 16×16 tiles
+    size_t blockedLayoutMinWidth = 4096;
+
+    /// Cost model of planFill(), in seconds per unit of work with all threads of the machine.
+    /// Finding the holes and the boundary, per image pixel
+    double scanSecondsPerPixel = 3.0e-10;
+    /// fill, per pair of hole and boundary pixels
+    double exactSecondsPerPair = 1.7e-8;
+    /// fillApproximate, per hole pixel
+    double approximateSecondsPerHole = 6.0e-8;
+    /// fillExactWithSearch, per hole pixel times k times log2(boundary + 2)
+    double searchSecondsPerNeighbor = 9.0e-9;
+    /// fillExactWithDualTreeSearch, per hole pixel times k times log2(boundary + 2)
+    double dualTreeSecondsPerNeighbor = 8.5e-9;
+    /// fillStochastic, per sample
+    double stochasticSecondsPerSample = 2.2e-7;
+};
+
+/**
+ * @brief Returns the process-wide tuning parameters used by the fill engines.
+ *
+ * On first use they are read from defaultTuningPath(). Without that file the defaults are used.
+ */
+Tuning& tuning();
+
+/**
+ * @brief Reads tuning parameters from a file written by saveTuning(), e.g. by holefill_tune.
+ *
+ * The file holds one "name = value" line per parameter, named as the fields of Tuning. Lines with
+ * unknown names or values out of range are skipped, and parameters without a line keep their value
+ * in tuning, so files from older or newer versions of the library are safe to read.
+ *
+ * @return false when the file cannot be opened, leaving tuning unchanged.
+ */
+bool loadTuning(const char* path, Tuning& tuning);
+
+/**
+ * @brief Writes every tuning parameter to a file that loadTuning() reads. Returns false on failure.
+ */
+bool saveTuning(const char* path, const Tuning& tuning);
+
+/**
+ * @brief Path of the tuning file tuning() reads on first use.
+ *
+ * The environment variable HOLEFILL_TUNING if set, so that each machine class of a fleet can be
+ * pointed at its own file; otherwise holefill/tuning.conf in the user's configuration directory,
+ * i.e. $XDG_CONFIG_HOME, ~/.config or %APPDATA%. Empty when none of these is known.
+ */
+std::string defaultTuningPath();
+
+/**
+ * @brief Instruction sets the hot loops of the fill engines are built for.
+ *
+ * The library contains one build of its hot loops per instruction set and uses the widest one the
+ * CPU supports, so a single binary runs at full speed on every x86-64 machine. Setting the
+ * environment variable HOLEFILL_ISA to one of the names returned by isaName() overrides the choice
+ * at startup; selectIsa() overrides it at runtime. Other platforms only have the scalar build.
+ */
+enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+/**
+ * @brief Returns the name of an instruction set: "scalar", "sse4.2", "avx2" or "avx512".
+ */
+const char* isaName(Isa isa);
+
+/**
+ * @brief Parses a name returned by isaName(). Returns false for unknown names.
+ */
+bool parseIsa(const char* name, Isa& isa);
+
+/**
+ * @brief Returns whether the library has a build for the instruction set and the CPU supports it.
+ */
+bool isaSupported(Isa isa);
+
+/**
+ * @brief Returns the instruction set whose build is in use.
+ */
+Isa activeIsa();
+
+/**
+ * @brief Switches all engines to the build for the given instruction set.
+ *
+ * Returns false, leaving the selection unchanged, when the instruction set is not supported.
+ * Must not be called while a fill is running.
+ */
+bool selectIsa(Isa isa);
+
+/**
+ * @brief Thrown when a fill cannot complete within its memory budget, even after degrading.
+ */
+struct MemoryBudgetExceeded : std::bad_alloc {
+    const char* what() const noexcept override { return "holefill: memory budget exceeded"; }
+};
+
+/**
+ * @brief Thrown when a fill is cancelled through FillOptions::cancel.
+ *
+ * Pixels that were not filled yet are still holes, i.e. negative.
+ */
+struct FillCancelled : std::runtime_error {
+    FillCancelled() : std::runtime_error("holefill: fill cancelled") {}
+};
+
+/**
+ * @brief Phases of a fill call, in the order in which they run.
+ */
+enum class FillPhase {
+    Detection,   ///< Finding the hole pixels
+    Boundary,    ///< Finding the boundary pixels
+    IndexBuild,  ///< Building search structures over the boundary or the holes
+    Query,       ///< Computing fill values. Engines that write each value as soon as it is computed write here too.
+    WriteBack    ///< Writing values computed by an earlier pass
+};
+
+constexpr size_t fillPhaseCount = 5;
+
+/**
+ * @brief Returns the lowercase name of a phase, e.g. "index_build".
+ */
+const char* phaseName(FillPhase phase);
+
+/**
+ * @brief Time and hardware events of one phase of a fill call.
+ *
+ * Events are counted in user space on every thread that worked on the phase, pool threads included.
+ * Counts are scaled up when the kernel had to multiplex the counters.
+ */
+struct PhaseStats {
+    /// Wall-clock time
+    double seconds = 0.0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    /// Level 1 data cache read misses
+    uint64_t l1dMisses = 0;
+    /// Last level cache misses
+    uint64_t llcMisses = 0;
+    uint64_t branchMisses = 0;
+};
+
+/**
+ * @brief Statistics of a single fill call.
+ */
+struct FillStats {
+    /// Largest amount of scratch memory held at any time during the call, in bytes
+    size_t peakScratchBytes = 0;
+    /// True when the engine ran out of budget and switched to a leaner algorithm
+    bool degraded = false;
+    /// Time and hardware events of each phase, indexed by FillPhase. A phase an engine re-enters,
+    /// e.g. after falling back to a leaner algorithm, accumulates.
+    std::array<PhaseStats, fillPhaseCount> phases{};
+    /// Whether the event counts in phases are valid. False when FillOptions::countEvents is off or
+    /// hardware events are unavailable: outside Linux, under a restrictive perf_event_paranoid setting
+    /// or in a virtual machine without a virtual PMU. Events the CPU cannot count stay zero.
+    bool eventsCounted = false;
+};
+
+/**
+ * @brief Per-call options shared by all fill engines.
+ *
+ * Every scratch allocation of a fill call goes through a counting memory resource. When the
+ * memory budget would be exceeded, the engine falls back to an algorithm that needs less
+ * scratch memory, as documented for each engine, and sets FillStats::degraded. If even the
+ * leanest algorithm does not fit, MemoryBudgetExceeded is thrown before the image is modified.
+ */
+struct FillOptions {
+    /// Upper bound on the scratch memory of the call in bytes, 0 for unlimited
+    size_t memoryBudget = 0;
+    /// Resource scratch memory is taken from, std::pmr::new_delete_resource() when null. Must be thread-safe.
+    std::pmr::memory_resource* upstream = nullptr;
+    /// Optional output, reset at the start of the call
+    FillStats* stats = nullptr;
+    /// Whether the result must be bitwise identical for any thread count and schedule. Sums over the
+    /// boundary are then reduced in fixed chunks combined pairwise. When false, sums run straight
+    /// through the boundary.
+    bool deterministic = true;
+    /// Checked between units of work; once stop is requested the engine throws FillCancelled
+    std::stop_token cancel;
+    /// Count hardware events per phase into FillStats::phases, through perf_event_open on Linux.
+    /// Costs a few system calls per phase and per parallel loop. Has no effect without stats.
+    bool countEvents = false;
+};
+
 /**
  * @brief Fills holes in an image using a weighted average of boundary pixels.
  *
@@ -37,12 +251,16 @@ using WeightFunction = std::function<float(const Coord&, const Coord&)>;
  * @param weightFunc Function that calculates the weight between two pixels based on their coordinates.
  *                   The weight should be higher for closer pixels and lower for distant pixels.
  *
+ * @param options Memory budget and statistics of the call.
+ *
  * @note The image is modified in-place. Hole pixels (negative values) are replaced with
- *       the weighted average of surrounding valid pixels.
+ *       the weighted average of surrounding valid pixels. Scratch memory is the list of boundary pixels.
+ *       Spans of hole pixels are filled in parallel, so weightFunc must be safe to call concurrently.
  *
  * @see fillApproximate for a faster but less accurate version that uses a fixed window size
  */
-void fill(float* image, const int32_t width, const int32_t height, WeightFunction weightFunc);
+void fill(float* image, const int32_t width, const int32_t height, WeightFunction weightFunc,
+          const FillOptions& options = {});
 
 /**
  * @brief Fills holes in an image using a fast linear-time algorithm that processes pixels from boundary inward.
@@ -60,14 +278,21 @@ void fill(float* image, const int32_t width, const int32_t height, WeightFunctio
  * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
  * @param width Width of the image in pixels
  * @param height Height of the image in pixels
+ * @param options Memory budget and statistics of the call.
  *
  * @note The image is modified in-place. Hole pixels (negative values) are replaced with
- *       the average of their non-hole neighbors.
+ *       the average of their non-hole neighbors. The image itself tracks which pixels are pending,
+ *       so the only scratch memory is a queue with one entry per hole pixel. Without budget for the
+ *       queue, the holes are filled by repeated sweeps over the image instead, one boundary layer
+ *       per sweep. When the box around the holes is at least tuning().blockedLayoutMinWidth pixels
+ *       wide and at least an eighth of it is holes, the fill runs in a copy of the box stored in
+ *       16×16 tiles, which keeps the neighbors of a pixel in nearby cache lines and pages; the
+ *       result is the same. Without budget for the copy, the fill runs in the image.
  *
  * @see fill for the full version that considers all boundary pixels
  * @see fillExactWithSearch for the KD-tree based version
  */
-void fillApproximate(float* image, const int32_t width, const int32_t height);
+void fillApproximate(float* image, const int32_t width, const int32_t height, const FillOptions& options = {});
 
 /**
  * @brief Fills holes in an image using a KD-tree for efficient k-nearest neighbor search.
@@ -101,15 +326,297 @@ void fillApproximate(float* image, const int32_t width, const int32_t height);
  * @param nearestNeighborMax Maximum number of nearest boundary pixels to consider for each hole pixel.
  *                          This parameter controls the trade-off between accuracy and performance.
  *                          A larger value will consider more boundary pixels but increase computation time.
+ * @param options Memory budget and statistics of the call.
  *
  * @note The image is modified in-place. Hole pixels are replaced with the weighted average
  *       of their k-nearest boundary pixels. The algorithm uses nanoflann's KD-tree implementation
- *       for efficient nearest neighbor search.
+ *       for efficient nearest neighbor search. Without budget for the KD-tree, every hole
+ *       pixel scans the whole boundary instead, which finds the same neighbors. Of several boundary
+ *       pixels as far as the k-th nearest, those first in row-major order are kept.
  *
  * @see fill for the full version that considers all boundary pixels
  * @see fillApproximate for the window-based approximate version
  */
 void fillExactWithSearch(float* image, int32_t width, int32_t height,
-                         WeightFunction weightFunc, const size_t nearestNeighborMax);
+                         WeightFunction weightFunc, const size_t nearestNeighborMax,
+                         const FillOptions& options = {});
+
+/**
+ * @brief The weight 1 / (d² + epsilon)^zeta of two pixels at squared distance d², as a weight function.
+ *
+ * Computed as exp(-zeta * log(d² + epsilon)), so that sweeps over zeta share the logarithm.
+ */
+struct PowerKernel {
+    float epsilon = 0.01f;
+    float zeta = 3.0f;
+
+    float operator()(const Coord& u, const Coord& v) const;
+
+    /// Weight from log(d² + epsilon)
+    float weight(float logDistance) const;
+};
+
+/**
+ * @brief One setting of a parameter sweep: the weights, the neighbor count and where the result goes.
+ */
+struct SweepSetting {
+    WeightFunction weightFunc;
+    /// Maximum number of nearest boundary pixels, used by fillExactWithSearchSweep only
+    size_t nearestNeighborMax = 0;
+    /// Receives a copy of the image with the holes filled with this setting: width * height floats
+    float* output = nullptr;
+    /// Weights of this setting in place of weightFunc, which is then not called. The sweeps compute
+    /// the squared distance of each pair of pixels once, and its logarithm once per distinct epsilon,
+    /// for all settings with a kernel, so that each of them only costs an exponential per pair.
+    std::optional<PowerKernel> kernel;
+};
+
+/**
+ * @brief Fills one copy of an image per setting as fill() would, in a single pass over the holes.
+ *
+ * Comparing weight functions, e.g. several exponents of the distance, with one fill() per setting
+ * finds the holes and the boundary and walks every pair of hole and boundary pixels again for each
+ * of them. This function finds them once, and each hole pixel reads every boundary pixel once and
+ * adds it to the weighted sums of all settings.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ *              It is not modified.
+ * @param settings Weight function or kernel and output of each setting; nearestNeighborMax is ignored.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note Each output is bitwise identical to fill() of the image with the same weight function, or
+ *       with the kernel as the weight function, and options. Outputs must not overlap the image or
+ *       each other.
+ */
+void fillSweep(const float* image, int32_t width, int32_t height, std::span<const SweepSetting> settings,
+               const FillOptions& options = {});
+
+/**
+ * @brief Fills one copy of an image per setting as fillExactWithSearch() would, in a single pass over the holes.
+ *
+ * Each hole pixel searches its nearest boundary pixels once, for the largest nearestNeighborMax of
+ * the settings, and each setting sums the weights of as many of the nearest of them as it asks for.
+ * The holes, the boundary and the KD-tree are built once for all settings.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ *              It is not modified.
+ * @param settings Weight function or kernel, neighbor count and output of each setting.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note Each output is bitwise identical to fillExactWithSearch() of the image with the same weight
+ *       function, or with the kernel as the weight function, neighbor count and options. Outputs must not overlap the image or each other.
+ */
+void fillExactWithSearchSweep(const float* image, int32_t width, int32_t height,
+                              std::span<const SweepSetting> settings, const FillOptions& options = {});
+
+/**
+ * @brief Fills holes by evaluating the exact fill sparsely and interpolating smooth interior regions.
+ *
+ * Deep inside a large hole every boundary pixel is far away, so the exact result of fill() varies
+ * slowly and does not need to be evaluated at every pixel. This function works as follows:
+ * 1. Covers the bounding box of the holes with a coarse lattice of cells of size maxCellSize
+ * 2. For each cell that lies entirely inside a hole and is at least its own size away from the boundary:
+ *    - Evaluates the exact weighted average at the cell corners and edge midpoints
+ *    - If bilinear interpolation of the corners reproduces the midpoints within tolerance,
+ *      the whole cell is filled by interpolation
+ *    - Otherwise the cell is subdivided into four and each quarter is tested again
+ * 3. Cells that touch valid pixels or lie close to the boundary are subdivided down to single pixels,
+ *    which are evaluated exactly
+ *
+ * Exact evaluations are cached, so lattice points shared between neighbouring cells and between
+ * a cell and its children are computed only once.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param weightFunc Function that calculates the weight between two pixels based on their coordinates.
+ *                   The weight should be higher for closer pixels and lower for distant pixels.
+ * @param tolerance Maximum allowed difference between an interpolated and an exact value at the
+ *                  probe points of a cell before the cell is subdivided.
+ * @param maxCellSize Size of the coarsest lattice cells in pixels. Rounded up to a power of two.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The image is modified in-place. Pixels near the boundary are identical to fill();
+ *       interior pixels differ from it by roughly the given tolerance. The lattice needs scratch
+ *       memory proportional to the bounding box of the holes; without budget for it, every
+ *       pixel is evaluated exactly as in fill().
+ *
+ * @see fill for the version that evaluates every hole pixel exactly
+ */
+void fillAdaptive(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                  float tolerance = 1.0e-3f, int32_t maxCellSize = 32, const FillOptions& options = {});
+
+/**
+ * @brief Fills large holes from the exact fill of a downsampled image, corrected exactly near the boundary.
+ *
+ * Deep inside a large hole the boundary is far away, so moving a boundary pixel by a few pixels hardly
+ * changes its weight and the exact result of fill() is smooth. This function works as follows:
+ * 1. Finds the band width from the decay of the weight function: the distance from a boundary pixel
+ *    beyond which moving it by factor pixels changes its weight by at most bandTolerance of it
+ * 2. Reduces the image by factor in each direction, a block whose pixels are all holes being a hole
+ *    and any other the mean of its valid pixels, and fills the reduced image as fill() does, with the weights
+ *    of the block centres. Only blocks the next step reads are evaluated.
+ * 3. Fills the hole pixels farther than the band width from every valid pixel by bilinear
+ *    interpolation of the reduced result
+ * 4. Fills the hole pixels within the band exactly as fill() does, where the kernel is sharp and
+ *    the reduced result is wrong
+ *
+ * With a factor of 2 or 4, the reduced fill has 4 or 16 times fewer hole pixels and 2 or 4 times
+ * fewer boundary pixels, so most of the cost of fill() on a large hole is either gone or moved to the
+ * band, whose width depends on the kernel and the factor but not on the size of the hole.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param weightFunc Function that calculates the weight between two pixels based on their coordinates.
+ *                   It is evaluated at block centres for the reduced image, so it should depend on the
+ *                   offset between the pixels only, and decrease with their distance.
+ * @param factor Reduction in each direction. 1 or less fills every pixel exactly.
+ * @param bandTolerance Largest relative change of a weight over factor pixels outside the band. Smaller
+ *                      values widen the band, trading time for accuracy.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The image is modified in-place. Pixels within the band are identical to fill(). Scratch memory
+ *       is a bit per pixel of the bounding box of the holes and two floats per block of it; without
+ *       budget for them, or when less than a quarter of the hole pixels lie outside the band, every
+ *       pixel is evaluated as in fill(): the reduced fill would then cost more than it saves.
+ *
+ * @see fill for the version that evaluates every hole pixel exactly
+ * @see fillAdaptive for a version that interpolates where the exact result is found to be smooth
+ */
+void fillMultiresolution(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                         int32_t factor = 2, float bandTolerance = 0.1f, const FillOptions& options = {});
+
+/**
+ * @brief How much of the image fillHybrid evaluated exactly.
+ */
+struct HybridFillReport {
+    size_t holePixels = 0;
+    /// Hole pixels filled exactly: the samples and checks, the pixels too close to the boundary or to
+    /// where the weights vanish to interpolate, and every hole pixel of the refined tiles
+    size_t refinedPixels = 0;
+    /// Tiles with hole pixels
+    size_t tiles = 0;
+    size_t refinedTiles = 0;
+    /// Hole pixels evaluated exactly to interpolate from or to estimate the error of the tiles
+    size_t samples = 0;
+
+    /// Share of the hole pixels that were filled exactly, from 0 to 1
+    double refinedFraction() const {
+        return holePixels ? static_cast<double>(refinedPixels) / static_cast<double>(holePixels) : 0.0;
+    }
+};
+
+/**
+ * @brief Fills holes by interpolating exact samples and refines exactly the tiles where that is found to be off.
+ *
+ * Away from the boundary the result of fill() varies slowly, while next to it the kernel is sharp.
+ * This function works as follows:
+ * 1. Evaluates fill() exactly on a lattice every tileSize / 4 pixels in each direction, keeping the
+ *    sum of the weights as well as their average
+ * 2. Estimates each hole pixel whose 4 × 4 surrounding lattice points all lie in the holes by
+ *    bilinear interpolation of the nearest four, or as zero where the weights vanish at all four as
+ *    fill() gives there. Pixels nearer the boundary, and those where the interpolated sum of weights
+ *    is within a factor of two of vanishing, are evaluated exactly.
+ * 3. Evaluates fill() exactly at the centre of every lattice cell with estimated pixels, where
+ *    interpolation is least accurate, and takes twice the largest difference found in a tile as its error
+ * 4. Fills every hole pixel of the tiles whose error exceeds the tolerance exactly as fill() does
+ *
+ * The lattice and the checks cost about 2 / (tileSize / 4)² of a full exact fill, and the pixels
+ * within two lattice cells of the boundary are evaluated exactly, so the time saved grows with the
+ * depth of the holes: thin holes and small blobs are filled almost entirely exactly.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param weightFunc Function that calculates the weight between two pixels based on their coordinates
+ * @param tolerance Largest estimated difference from fill() of the tiles that are not refined
+ * @param tileSize Width and height of the tiles that are refined as a whole
+ * @param options Memory budget and statistics of the call.
+ * @return How many tiles and hole pixels were filled exactly
+ *
+ * @note The image is modified in-place. Pixels filled exactly are identical to fill(). The tolerance
+ *       is only checked at the centres of the lattice cells: it is an estimate of the error of the
+ *       other pixels, not a bound, and where the result bends sharply between two checks it can be
+ *       exceeded. Without budget for the lattice, every pixel is evaluated as in fill().
+ *
+ * @see fillAdaptive for a version that subdivides cells until interpolation holds
+ * @see fillAuto for choosing a single engine for the whole image from a tolerance
+ */
+HybridFillReport fillHybrid(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                            float tolerance = 1.0e-2f, int32_t tileSize = 16, const FillOptions& options = {});
+
+/**
+ * @brief Fills holes by Monte Carlo estimation of the full weighted average.
+ *
+ * With very large boundaries the full fill is too expensive and k-nearest-neighbor truncation
+ * biases the result. This function keeps the cost per hole pixel fixed instead:
+ * 1. Buckets the boundary pixels into a uniform grid whose cell size grows with the boundary length
+ * 2. For each hole pixel, bounds the weight of every cell by evaluating the weight function at the
+ *    closest point of the cell's bounding box, scaled by the number of pixels in the cell
+ * 3. Sums the cells adjacent to the hole pixel exactly
+ * 4. Draws samplesPerPixel boundary pixels from the remaining cells in proportion to their bounds
+ *    and accumulates importance-weighted estimates of the numerator and denominator
+ *
+ * The numerator and denominator estimates are unbiased; their ratio converges to the fill() result
+ * as samplesPerPixel grows. Results are deterministic for a given seed.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param weightFunc Function that calculates the weight between two pixels based on their coordinates.
+ *                   The weight must decrease monotonically with distance, as the cell bounds rely on it.
+ * @param samplesPerPixel Number of boundary pixels sampled for each hole pixel.
+ * @param variance Optional output of width * height floats. When not null, the estimated variance of
+ *                 each filled value is written at the hole pixels, e.g. to drive a denoising pass.
+ * @param seed Seed of the per-pixel random sequences.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The image is modified in-place. Cost per hole pixel is independent of the boundary size
+ *       apart from the grid bounds, whose count is capped. Without budget for the grid, the holes
+ *       are filled exactly as in fill() and the variance is zero.
+ *
+ * @see fill for the exact version that sums every boundary pixel
+ */
+void fillStochastic(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                    size_t samplesPerPixel, float* variance = nullptr, uint64_t seed = 0,
+                    const FillOptions& options = {});
+
+/**
+ * @brief Fills holes using a dual-tree k-nearest neighbor search over hole and boundary pixels.
+ *
+ * This function produces the same result as fillExactWithSearch, bitwise, but instead of running
+ * an independent tree query for every hole pixel it answers whole groups of queries at once:
+ * 1. Builds one KD-tree over the boundary pixels and a second one over the hole pixels
+ * 2. Traverses pairs of hole and boundary nodes together, pruning a pair when the distance
+ *    between their bounding boxes exceeds the worst k-th neighbor distance in the hole node
+ * 3. Compares points directly only for pairs of leaves that survive pruning
+ * 4. Takes the weighted average of the k nearest boundary pixels of each hole pixel
+ *
+ * The upper levels of the boundary tree are visited once per hole node rather than once per
+ * hole pixel, but on a single thread that saves no time: the dualtree benchmark of holefill_bench
+ * measures 0.6 to 1.0 times the speed of fillExactWithSearch, the lowest for thin rings. The
+ * gain comes from traversing subtrees of the hole tree in parallel, where fillExactWithSearch
+ * answers its queries on one thread, so prefer this function for large holes on many cores.
+ * Equally distant neighbors are kept in row-major order as in fillExactWithSearch, so the result
+ * does not depend on how the hole tree is split among threads.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ * @param width Width of the image in pixels
+ * @param height Height of the image in pixels
+ * @param weightFunc Function that calculates the weight between two pixels based on their coordinates.
+ *                   The weight should be higher for closer pixels and lower for distant pixels.
+ * @param nearestNeighborMax Maximum number of nearest boundary pixels to consider for each hole pixel.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The image is modified in-place. The neighbor lists of all hole pixels are held at once,
+ *       which takes nearestNeighborMax * 12 bytes per hole pixel; without budget for them the
+ *       single-tree fillExactWithSearch is used instead, as for images wider or taller than 46340 pixels.
+ *
+ * @see fillExactWithSearch for the single-tree version
+ */
+void fillExactWithDualTreeSearch(float* image, int32_t width, int32_t height,
+                                 WeightFunction weightFunc, size_t nearestNeighborMax,
+                                 const FillOptions& options = {});
 
 } // namespace holefill
@@ -0,0 +1,693 @@
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <optional>
+#include <thread>
+
+#include "holefill3d.h"
+#include "parallel.h"
+#include "holespans.h"
+#include "scratch.h"
+#include "nanoflann.hpp"
+
+namespace holefill {
+
+// Dimensions of a volume and voxel addressing
+struct VolumeShape {
+    int32_t width;
+    int32_t height;
+    int32_t depth;
+
+    size_t rowCount() const { return static_cast<size_t>(height) * depth; }
+
+    size_t index(const int32_t x, const int32_t y, const int32_t z) const {
+        return (static_cast<size_t>(z) * height + y) * width + x;
+    }
+
+    bool contains(const int32_t x, const int32_t y, const int32_t z) const {
+        return x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth;
+    }
+};
+
+// 26-connected neighbor offsets
+struct Offsets3D {
+    Coord3 offsets[26];
+
+    Offsets3D() {
+        size_t i = 0;
+        for (int32_t dz = -1; dz <= 1; ++dz) {
+            for (int32_t dy = -1; dy <= 1; ++dy) {
+                for (int32_t dx = -1; dx <= 1; ++dx) {
+                    if (dx != 0 || dy != 0 || dz != 0) offsets[i++] = {dx, dy, dz};
+                }
+            }
+        }
+    }
+};
+
+static const Offsets3D neighbors3D;
+
+// One bit per voxel. Rows start on a word boundary so that slabs can be written concurrently.
+struct VoxelBits {
+    size_t wordsPerRow;
+    std::pmr::vector<uint64_t> words;
+
+    VoxelBits(const VolumeShape& shape, std::pmr::memory_resource* const resource)
+        : wordsPerRow((static_cast<size_t>(shape.width) + 63) / 64),
+          words(wordsPerRow * shape.rowCount(), 0, resource) {}
+
+    const uint64_t* row(const size_t r) const { return &words[r * wordsPerRow]; }
+    uint64_t* row(const size_t r) { return &words[r * wordsPerRow]; }
+
+    bool test(const size_t r, const int32_t x) const {
+        return (row(r)[x >> 6] >> (x & 63)) & 1u;
+    }
+
+    bool rowEmpty(const size_t r) const {
+        const uint64_t* const w = row(r);
+        for (size_t i = 0; i < wordsPerRow; ++i) {
+            if (w[i] != 0) return false;
+        }
+        return true;
+    }
+
+    // Calls f(x) for every set bit of row r
+    template <typename F>
+    void forEach(const size_t r, F f) const {
+        const uint64_t* const w = row(r);
+        for (size_t i = 0; i < wordsPerRow; ++i) {
+            for (uint64_t bits = w[i]; bits != 0; bits &= bits - 1) {
+                f(static_cast<int32_t>(i * 64 + std::countr_zero(bits)));
+            }
+        }
+    }
+};
+
+// Marks every voxel with a negative value, one slab per task
+VoxelBits findHoleVoxels(const float* const volume, const VolumeShape& shape, std::pmr::memory_resource* const resource) {
+    VoxelBits holes(shape, resource);
+
+    parallelFor(static_cast<size_t>(shape.depth), [&](const size_t z) {
+        for (int32_t y = 0; y < shape.height; ++y) {
+            const size_t r = z * shape.height + y;
+            const float* const values = &volume[shape.index(0, y, static_cast<int32_t>(z))];
+            uint64_t* const bits = holes.row(r);
+            for (int32_t x = 0; x < shape.width; ++x) {
+                bits[x >> 6] |= static_cast<uint64_t>(values[x] < 0.0f) << (x & 63);
+            }
+        }
+    });
+
+    return holes;
+}
+
+struct BoundaryVoxels {
+    std::pmr::vector<Coord3> coords;   // Sorted by z, then y, then x
+    std::pmr::vector<float> values;
+
+    explicit BoundaryVoxels(std::pmr::memory_resource* const resource) : coords(resource), values(resource) {}
+};
+
+// Collects the valid voxels that have a hole among their 26 neighbors
+BoundaryVoxels findBoundaryVoxels(const float* const volume, const VolumeShape& shape, const VoxelBits& holes,
+                                  std::pmr::memory_resource* const resource) {
+    // Rows without holes are common in large volumes; rows whose 3x3 neighborhood of rows is empty are skipped
+    std::pmr::vector<uint8_t> rowHasHole(shape.rowCount(), resource);
+    parallelFor(static_cast<size_t>(shape.depth), [&](const size_t z) {
+        for (int32_t y = 0; y < shape.height; ++y) {
+            const size_t r = z * shape.height + y;
+            rowHasHole[r] = holes.rowEmpty(r) ? 0 : 1;
+        }
+    });
+
+    std::pmr::vector<std::pmr::vector<Coord3>> slabs(static_cast<size_t>(shape.depth), resource);
+
+    parallelFor(static_cast<size_t>(shape.depth), [&](const size_t slab) {
+        const int32_t z = static_cast<int32_t>(slab);
+        for (int32_t y = 0; y < shape.height; ++y) {
+            bool nearHole = false;
+            for (int32_t dz = -1; dz <= 1 && !nearHole; ++dz) {
+                for (int32_t dy = -1; dy <= 1 && !nearHole; ++dy) {
+                    nearHole = shape.contains(0, y + dy, z + dz) &&
+                               rowHasHole[static_cast<size_t>(z + dz) * shape.height + (y + dy)] != 0;
+                }
+            }
+            if (!nearHole) continue;
+
+            for (int32_t x = 0; x < shape.width; ++x) {
+                if (volume[shape.index(x, y, z)] < 0.0f) continue;
+
+                for (const Coord3& off : neighbors3D.offsets) {
+                    const int32_t nx = x + off.x;
+                    const int32_t ny = y + off.y;
+                    const int32_t nz = z + off.z;
+                    if (shape.contains(nx, ny, nz) && holes.test(static_cast<size_t>(nz) * shape.height + ny, nx)) {
+                        slabs[slab].push_back({x, y, z});
+                        break;
+                    }
+                }
+            }
+        }
+    });
+
+    BoundaryVoxels boundary(resource);
+    size_t total = 0;
+    for (const auto& slab : slabs) total += slab.size();
+    boundary.coords.reserve(total);
+    boundary.values.reserve(total);
+
+    for (auto& slab : slabs) {
+        for (const Coord3& v : slab) {
+            boundary.coords.push_back(v);
+            boundary.values.push_back(volume[shape.index(v.x, v.y, v.z)]);
+        }
+        slab = std::pmr::vector<Coord3>(resource);
+    }
+
+    return boundary;
+}
+
+inline float weightedAverage3D(const Coord3& u, const BoundaryVoxels& boundary, const WeightFunction3& weightFunc) {
+    float numerator = 0.0f;
+    float denominator = 0.0f;
+
+    for (size_t i = 0; i < boundary.coords.size(); ++i) {
+        const float w = weightFunc(u, boundary.coords[i]);
+        numerator += w * boundary.values[i];
+        denominator += w;
+    }
+
+    return (denominator > std::numeric_limits<float>::epsilon())
+        ? numerator / denominator
+        : 0.0f;  // Fallback value
+}
+
+void fill3D(float* const volume, const int32_t width, const int32_t height, const int32_t depth,
+            const WeightFunction3 weightFunc, const FillOptions& options) {
+    ScratchResource scratch(options);
+    const VolumeShape shape{width, height, depth};
+    scratch.enterPhase(FillPhase::Detection);
+    const VoxelBits holes = findHoleVoxels(volume, shape, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const BoundaryVoxels boundary = findBoundaryVoxels(volume, shape, holes, &scratch);
+
+    // Boundary values were copied, so writing hole voxels cannot affect other slabs
+    scratch.enterPhase(FillPhase::Query);
+    parallelFor(static_cast<size_t>(depth), [&](const size_t slab) {
+        scratch.checkCancelled();
+        const int32_t z = static_cast<int32_t>(slab);
+        for (int32_t y = 0; y < height; ++y) {
+            holes.forEach(slab * height + y, [&](const int32_t x) {
+                volume[shape.index(x, y, z)] = weightedAverage3D(Coord3{x, y, z}, boundary, weightFunc);
+            });
+        }
+    });
+}
+
+// Layers of fillApproximate3D found from a frontier of the voxels of each layer
+void fillApproximate3DByLayers(float* const volume, const VolumeShape& shape, ScratchResource& scratch) {
+    const int32_t width = shape.width;
+    const int32_t height = shape.height;
+    const int32_t depth = shape.depth;
+
+    // Unvisited hole voxels hold -1 and voxels already scheduled for a layer hold -2
+    constexpr float unvisited = -1.0f;
+    constexpr float scheduled = -2.0f;
+
+    parallelFor(static_cast<size_t>(depth), [&](const size_t z) {
+        float* const slab = &volume[shape.index(0, 0, static_cast<int32_t>(z))];
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+            if (slab[i] < 0.0f) slab[i] = unvisited;
+        }
+    });
+
+    const auto hasValidNeighbor = [&](const int32_t x, const int32_t y, const int32_t z) {
+        for (const Coord3& off : neighbors3D.offsets) {
+            const int32_t nx = x + off.x;
+            const int32_t ny = y + off.y;
+            const int32_t nz = z + off.z;
+            if (shape.contains(nx, ny, nz) && volume[shape.index(nx, ny, nz)] >= 0.0f) return true;
+        }
+        return false;
+    };
+
+    // First layer: hole voxels touching a valid voxel, found slab by slab
+    std::pmr::vector<std::pmr::vector<size_t>> slabFrontiers(static_cast<size_t>(depth), &scratch);
+    parallelFor(static_cast<size_t>(depth), [&](const size_t slab) {
+        const int32_t z = static_cast<int32_t>(slab);
+        for (int32_t y = 0; y < height; ++y) {
+            for (int32_t x = 0; x < width; ++x) {
+                if (volume[shape.index(x, y, z)] < 0.0f && hasValidNeighbor(x, y, z)) {
+                    slabFrontiers[slab].push_back(shape.index(x, y, z));
+                }
+            }
+        }
+    });
+
+    std::pmr::vector<size_t> frontier(&scratch);
+    for (auto& slab : slabFrontiers) {
+        frontier.insert(frontier.end(), slab.begin(), slab.end());
+        slab = std::pmr::vector<size_t>(&scratch);
+    }
+    for (const size_t i : frontier) volume[i] = scheduled;
+
+    constexpr size_t chunkSize = 4096;
+    std::pmr::vector<float> values(&scratch);
+
+    while (!frontier.empty()) {
+        scratch.checkCancelled();
+        const size_t chunks = (frontier.size() + chunkSize - 1) / chunkSize;
+
+        // Every voxel of the layer only reads voxels filled by earlier layers
+        values.resize(frontier.size());
+        parallelFor(chunks, [&](const size_t c) {
+            const size_t end = std::min(frontier.size(), (c + 1) * chunkSize);
+            for (size_t i = c * chunkSize; i < end; ++i) {
+                const int32_t x = static_cast<int32_t>(frontier[i] % width);
+                const int32_t y = static_cast<int32_t>((frontier[i] / width) % height);
+                const int32_t z = static_cast<int32_t>(frontier[i] / (static_cast<size_t>(width) * height));
+
+                float sum = 0.0f;
+                int32_t count = 0;
+                for (const Coord3& off : neighbors3D.offsets) {
+                    const int32_t nx = x + off.x;
+                    const int32_t ny = y + off.y;
+                    const int32_t nz = z + off.z;
+                    if (shape.contains(nx, ny, nz)) {
+                        const float value = volume[shape.index(nx, ny, nz)];
+                        if (value >= 0.0f) {
+                            sum += value;
+                            ++count;
+                        }
+                    }
+                }
+                values[i] = (count > 0) ? sum / count : 0.0f;
+            }
+        });
+
+        parallelFor(chunks, [&](const size_t c) {
+            const size_t end = std::min(frontier.size(), (c + 1) * chunkSize);
+            for (size_t i = c * chunkSize; i < end; ++i) volume[frontier[i]] = values[i];
+        });
+
+        // Next layer: unvisited neighbors of this layer, claimed atomically so each is scheduled once
+        std::pmr::vector<std::pmr::vector<size_t>> next(chunks, &scratch);
+        parallelFor(chunks, [&](const size_t c) {
+            const size_t end = std::min(frontier.size(), (c + 1) * chunkSize);
+            for (size_t i = c * chunkSize; i < end; ++i) {
+                const int32_t x = static_cast<int32_t>(frontier[i] % width);
+                const int32_t y = static_cast<int32_t>((frontier[i] / width) % height);
+                const int32_t z = static_cast<int32_t>(frontier[i] / (static_cast<size_t>(width) * height));
+
+                for (const Coord3& off : neighbors3D.offsets) {
+                    const int32_t nx = x + off.x;
+                    const int32_t ny = y + off.y;
+                    const int32_t nz = z + off.z;
+                    if (!shape.contains(nx, ny, nz)) continue;
+
+                    const size_t n = shape.index(nx, ny, nz);
+                    std::atomic_ref<float> voxel(volume[n]);
+                    float expected = unvisited;
+                    if (voxel.load(std::memory_order_relaxed) == unvisited &&
+                        voxel.compare_exchange_strong(expected, scheduled, std::memory_order_relaxed)) {
+                        next[c].push_back(n);
+                    }
+                }
+            }
+        });
+
+        frontier.clear();
+        for (const auto& part : next) frontier.insert(frontier.end(), part.begin(), part.end());
+    }
+}
+
+// Layers of fillApproximate3D without a frontier. Every pass fills the hole voxels next to valid
+// voxels, which are the voxels of the next layer of fillApproximate3DByLayers, so the results are
+// the same. Unfilled holes hold NaN during the passes, and the voxels filled by a pass hold their
+// negated value until the pass is over, so that they still read as holes. Valid voxels of -0.0 are
+// stored as +0.0 to tell them apart.
+void fillApproximate3DBySweeps(float* const volume, const VolumeShape& shape, ScratchResource& scratch) {
+    const size_t sliceSize = static_cast<size_t>(shape.width) * shape.height;
+    const float unfilled = std::numeric_limits<float>::quiet_NaN();
+    const auto isValid = [](const float value) { return !std::isnan(value) && !std::signbit(value); };
+    const auto isFilled = [](const float value) { return !std::isnan(value) && std::signbit(value); };
+
+    parallelFor(static_cast<size_t>(shape.depth), [&](const size_t z) {
+        float* const slice = volume + z * sliceSize;
+        for (size_t i = 0; i < sliceSize; ++i) {
+            if (slice[i] < 0.0f) slice[i] = unfilled;
+            else if (slice[i] == 0.0f) slice[i] = 0.0f;
+        }
+    });
+
+    for (bool filled = true; filled;) {
+        if (scratch.cancelled()) {
+            // Holes left unfilled go back to -1 so that the volume reads as it would after the layers
+            parallelFor(static_cast<size_t>(shape.depth), [&](const size_t z) {
+                float* const slice = volume + z * sliceSize;
+                for (size_t i = 0; i < sliceSize; ++i) {
+                    if (std::isnan(slice[i])) slice[i] = -1.0f;
+                }
+            });
+            scratch.checkCancelled();
+        }
+        std::atomic<bool> any{false};
+
+        // A slice reads its neighbors in the adjacent slices, so even and odd slices take turns
+        for (int32_t parity = 0; parity < 2; ++parity) {
+            parallelFor(static_cast<size_t>(shape.depth + 1 - parity) / 2, [&](const size_t i) {
+                const int32_t z = static_cast<int32_t>(2 * i) + parity;
+                bool changed = false;
+                for (int32_t y = 0; y < shape.height; ++y) {
+                    for (int32_t x = 0; x < shape.width; ++x) {
+                        float& voxel = volume[shape.index(x, y, z)];
+                        if (!std::isnan(voxel)) continue;
+
+                        float sum = 0.0f;
+                        int32_t count = 0;
+                        for (const Coord3& off : neighbors3D.offsets) {
+                            const int32_t nx = x + off.x;
+                            const int32_t ny = y + off.y;
+                            const int32_t nz = z + off.z;
+                            if (shape.contains(nx, ny, nz)) {
+                                const float value = volume[shape.index(nx, ny, nz)];
+                                if (isValid(value)) {
+                                    sum += value;
+                                    ++count;
+                                }
+                            }
+                        }
+                        if (count > 0) {
+                            voxel = -(sum / count);
+                            changed = true;
+                        }
+                    }
+                }
+                if (changed) any.store(true, std::memory_order_relaxed);
+            });
+        }
+
+        filled = any.load();
+        parallelFor(static_cast<size_t>(shape.depth), [&](const size_t z) {
+            float* const slice = volume + z * sliceSize;
+            for (size_t i = 0; i < sliceSize; ++i) {
+                if (isFilled(slice[i])) slice[i] = -slice[i];
+                else if (!filled && std::isnan(slice[i])) slice[i] = -1.0f;  // Out of reach, as the layers leave it
+            }
+        });
+    }
+}
+
+// Body of fillApproximate3D, with the scratch memory of a caller that may hold some of its own
+void fillApproximate3DWith(float* const volume, const VolumeShape& shape, ScratchResource& scratch) {
+    try {
+        fillApproximate3DByLayers(volume, shape, scratch);
+    } catch (const MemoryBudgetExceeded&) {
+        // Voxels of the layers that fitted stay filled, the sweeps go on from there
+        scratch.degrade();
+        fillApproximate3DBySweeps(volume, shape, scratch);
+    }
+}
+
+void fillApproximate3D(float* const volume, const int32_t width, const int32_t height, const int32_t depth,
+                       const FillOptions& options) {
+    ScratchResource scratch(options);
+    scratch.enterPhase(FillPhase::Query);
+    fillApproximate3DWith(volume, VolumeShape{width, height, depth}, scratch);
+}
+
+// Adaptor for nanoflann
+struct CoordCloud3 {
+    const std::pmr::vector<Coord3>* points;
+
+    size_t kdtree_get_point_count() const { return points->size(); }
+
+    float kdtree_get_pt(const size_t idx, const size_t dim) const {
+        const Coord3& p = (*points)[idx];
+        return (dim == 0) ? static_cast<float>(p.x)
+             : (dim == 1) ? static_cast<float>(p.y)
+                          : static_cast<float>(p.z);
+    }
+
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX&) const { return false; }
+};
+
+// Nanoflann result set that keeps the k nearest boundary voxels nearest first, ties to the lower index,
+// which is the lower position in the volume, so that which of several equally distant voxels are kept
+// does not depend on the leaf size. Leaves only offer points closer than worstDist(), which is
+// therefore just above the k-th distance. The scan without a tree offers every voxel to it.
+struct SortedResultSet3 {
+    using DistanceType = float;
+
+    size_t k;
+    size_t* indices;
+    float* distances;
+    size_t found = 0;
+
+    bool addPoint(const float distance, const size_t index) {
+        const auto before = [&](const size_t at) {
+            return distances[at] > distance || (distances[at] == distance && indices[at] > index);
+        };
+        if (found == k && !before(k - 1)) return true;
+
+        size_t at = (found < k) ? found++ : k - 1;
+        for (; at > 0 && before(at - 1); --at) {
+            distances[at] = distances[at - 1];
+            indices[at] = indices[at - 1];
+        }
+        distances[at] = distance;
+        indices[at] = index;
+        return true;
+    }
+
+    float worstDist() const {
+        return found < k ? std::numeric_limits<float>::max()
+                         : std::nextafter(distances[k - 1], std::numeric_limits<float>::max());
+    }
+
+    void sort() {}
+    bool full() const { return found == k; }
+};
+
+void fillExactWithSearch3D(float* const volume, const int32_t width, const int32_t height, const int32_t depth,
+                           const WeightFunction3 weightFunc, const size_t nearestNeighborMax, const FillOptions& options) {
+    ScratchResource scratch(options);
+    const VolumeShape shape{width, height, depth};
+    scratch.enterPhase(FillPhase::Detection);
+    const VoxelBits holes = findHoleVoxels(volume, shape, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const BoundaryVoxels boundary = findBoundaryVoxels(volume, shape, holes, &scratch);
+
+    const CoordCloud3 cloud{&boundary.coords};
+
+    using KDTree = nanoflann::KDTreeSingleIndexAdaptor<
+        nanoflann::L2_Simple_Adaptor<float, CoordCloud3>,
+        CoordCloud3, 3, size_t>;
+
+    const size_t k = std::min(nearestNeighborMax, boundary.coords.size());
+
+    // Query buffers for every slab up front, so that running out of budget leaves the volume as it was
+    scratch.enterPhase(FillPhase::IndexBuild);
+    std::pmr::vector<size_t> indices(static_cast<size_t>(depth) * k, &scratch);
+    std::pmr::vector<float> distances(static_cast<size_t>(depth) * k, &scratch);
+
+    // Without budget for the tree every query scans the whole boundary
+    const size_t leafSize = tuning().floatTreeLeafSize;
+    std::optional<ScratchCharge> treeCharge;
+    try {
+        treeCharge.emplace(scratch, nanoflannIndexBytes(boundary.coords.size(), leafSize));
+    } catch (const MemoryBudgetExceeded&) {
+        scratch.degrade();
+    }
+
+    std::optional<KDTree> tree;
+    if (treeCharge) {
+        tree.emplace(3, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(leafSize));
+        tree->buildIndex();
+    }
+
+    scratch.enterPhase(FillPhase::Query);
+    parallelFor(static_cast<size_t>(depth), [&](const size_t slab) {
+        scratch.checkCancelled();
+        const int32_t z = static_cast<int32_t>(slab);
+        size_t* const slabIndices = indices.data() + slab * k;
+        float* const slabDistances = distances.data() + slab * k;
+
+        for (int32_t y = 0; y < height; ++y) {
+            holes.forEach(slab * height + y, [&](const int32_t x) {
+                const Coord3 u{x, y, z};
+                SortedResultSet3 result{k, slabIndices, slabDistances};
+                if (k == 0) {
+                    // No boundary, fall through to the fallback value
+                } else if (tree) {
+                    const float queryPt[3] = { static_cast<float>(x), static_cast<float>(y), static_cast<float>(z) };
+                    tree->findNeighbors(result, queryPt);
+                } else {
+                    for (size_t b = 0; b < boundary.coords.size(); ++b) {
+                        const Coord3& v = boundary.coords[b];
+                        const float dx = static_cast<float>(x - v.x);
+                        const float dy = static_cast<float>(y - v.y);
+                        const float dz = static_cast<float>(z - v.z);
+                        result.addPoint(dx * dx + dy * dy + dz * dz, b);
+                    }
+                }
+                const size_t found = result.found;
+
+                float numerator = 0.0f;
+                float denominator = 0.0f;
+
+                for (size_t i = 0; i < found; ++i) {
+                    const float w = weightFunc(u, boundary.coords[slabIndices[i]]);
+                    numerator += w * boundary.values[slabIndices[i]];
+                    denominator += w;
+                }
+
+                volume[shape.index(x, y, z)] = (denominator > std::numeric_limits<float>::epsilon())
+                    ? numerator / denominator
+                    : 0.0f;  // Fallback value
+            });
+        }
+    });
+}
+
+void fillConvolution3D(float* const volume, const int32_t width, const int32_t height, const int32_t depth,
+                       const WeightFunction3 weightFunc, const int32_t radius, const FillOptions& options) {
+    ScratchResource scratch(options);
+    const VolumeShape shape{width, height, depth};
+    scratch.enterPhase(FillPhase::Detection);
+    const VoxelBits holeVoxels = findHoleVoxels(volume, shape, &scratch);
+    scratch.enterPhase(FillPhase::Boundary);
+    const BoundaryVoxels boundary = findBoundaryVoxels(volume, shape, holeVoxels, &scratch);
+
+    // Kernel table indexed by the offset from boundary voxel to hole voxel
+    scratch.enterPhase(FillPhase::IndexBuild);
+    const int32_t side = 2 * radius + 1;
+    std::pmr::vector<float> kernel(static_cast<size_t>(side) * side * side, &scratch);
+    for (int32_t dz = -radius; dz <= radius; ++dz) {
+        for (int32_t dy = -radius; dy <= radius; ++dy) {
+            for (int32_t dx = -radius; dx <= radius; ++dx) {
+                kernel[(static_cast<size_t>(dz + radius) * side + (dy + radius)) * side + (dx + radius)] =
+                    weightFunc(Coord3{dx, dy, dz}, Coord3{0, 0, 0});
+            }
+        }
+    }
+
+    // Boundary voxels within reach of the slabs [z0, z1)
+    const auto reach = [&](const int32_t z0, const int32_t z1) {
+        const auto byZ = [](const Coord3& v, const int32_t z) { return v.z < z; };
+        return std::pair(std::lower_bound(boundary.coords.begin(), boundary.coords.end(), z0 - radius, byZ),
+                         std::lower_bound(boundary.coords.begin(), boundary.coords.end(), z1 + radius, byZ));
+    };
+
+    try {
+        // The volume as an image of height * depth rows, so a span's row is the voxel row index
+        const HoleSpans holes(volume, width, static_cast<int32_t>(shape.rowCount()), &scratch);
+
+        // Accumulators are addressed by the rank of the hole voxel: hole voxels in earlier spans plus
+        // the offset within the span. rowSpans[r] is the first span of row r.
+        std::pmr::vector<size_t> rowSpans(shape.rowCount() + 1, 0, &scratch);
+        std::pmr::vector<size_t> spanRank(holes.spans.size() + 1, 0, &scratch);
+        for (size_t s = 0; s < holes.spans.size(); ++s) {
+            const HoleSpan& span = holes.spans[s];
+            ++rowSpans[static_cast<size_t>(span.y) + 1];
+            spanRank[s + 1] = spanRank[s] + static_cast<size_t>(span.x1 - span.x0);
+        }
+        for (size_t r = 0; r < shape.rowCount(); ++r) rowSpans[r + 1] += rowSpans[r];
+
+        std::pmr::vector<float> numerators(holes.pixelCount, 0.0f, &scratch);
+        std::pmr::vector<float> denominators(holes.pixelCount, 0.0f, &scratch);
+
+        // Each task owns a slab of target voxels and scatters every boundary voxel within reach of it
+        scratch.enterPhase(FillPhase::Query);
+        const size_t slabDepth = std::max<size_t>(1, static_cast<size_t>(depth) / (4 * std::max(1u, std::thread::hardware_concurrency())));
+        const size_t slabCount = (static_cast<size_t>(depth) + slabDepth - 1) / slabDepth;
+
+        parallelFor(slabCount, [&](const size_t slab) {
+            scratch.checkCancelled();
+            const int32_t z0 = static_cast<int32_t>(slab * slabDepth);
+            const int32_t z1 = static_cast<int32_t>(std::min<size_t>(depth, (slab + 1) * slabDepth));
+            const auto [first, last] = reach(z0, z1);
+
+            for (auto it = first; it != last; ++it) {
+                const Coord3& v = *it;
+                const float value = boundary.values[it - boundary.coords.begin()];
+                const int32_t x0 = std::max(0, v.x - radius);
+                const int32_t x1 = std::min(width - 1, v.x + radius);
+
+                for (int32_t z = std::max(z0, v.z - radius); z < std::min(z1, v.z + radius + 1); ++z) {
+                    for (int32_t y = std::max(0, v.y - radius); y <= std::min(height - 1, v.y + radius); ++y) {
+                        const size_t r = static_cast<size_t>(z) * height + y;
+                        const size_t kernelRow = (static_cast<size_t>(z - v.z + radius) * side + (y - v.y + radius)) * side;
+
+                        // Rows without holes have no spans and are passed over without a scan
+                        for (size_t s = rowSpans[r]; s < rowSpans[r + 1]; ++s) {
+                            const HoleSpan& span = holes.spans[s];
+                            if (span.x0 > x1) break;
+                            if (span.x1 <= x0) continue;
+
+                            const int32_t begin = std::max(x0, span.x0);
+                            const int32_t end = std::min(x1 + 1, span.x1);
+                            const size_t rank = spanRank[s] + static_cast<size_t>(begin - span.x0);
+                            for (int32_t x = begin; x < end; ++x) {
+                                const float w = kernel[kernelRow + (x - v.x + radius)];
+                                numerators[rank + (x - begin)] += w * value;
+                                denominators[rank + (x - begin)] += w;
+                            }
+                        }
+                    }
+                }
+            }
+        });
+
+        scratch.enterPhase(FillPhase::WriteBack);
+        parallelFor(static_cast<size_t>(depth), [&](const size_t slab) {
+            for (size_t s = rowSpans[slab * height]; s < rowSpans[(slab + 1) * height]; ++s) {
+                const HoleSpan& span = holes.spans[s];
+                float* const row = volume + static_cast<size_t>(span.y) * width;
+                for (int32_t x = span.x0; x < span.x1; ++x) {
+                    const size_t rank = spanRank[s] + static_cast<size_t>(x - span.x0);
+                    if (denominators[rank] > std::numeric_limits<float>::epsilon()) {
+                        row[x] = numerators[rank] / denominators[rank];
+                    }
+                }
+            }
+        });
+    } catch (const MemoryBudgetExceeded&) {
+        // Without the accumulators every hole voxel gathers the boundary voxels within reach. They are
+        // summed in the same order as the scatter adds them, so the result is the same.
+        scratch.degrade();
+        scratch.enterPhase(FillPhase::Query);
+        parallelFor(static_cast<size_t>(depth), [&](const size_t slab) {
+            scratch.checkCancelled();
+            const int32_t z = static_cast<int32_t>(slab);
+            const auto [first, last] = reach(z, z + 1);
+
+            for (int32_t y = 0; y < height; ++y) {
+                holeVoxels.forEach(slab * height + y, [&](const int32_t x) {
+                    float numerator = 0.0f;
+                    float denominator = 0.0f;
+                    for (auto it = first; it != last; ++it) {
+                        const Coord3& v = *it;
+                        if (std::abs(v.x - x) > radius || std::abs(v.y - y) > radius || std::abs(v.z - z) > radius) continue;
+
+                        const float w = kernel[(static_cast<size_t>(z - v.z + radius) * side + (y - v.y + radius)) * side + (x - v.x + radius)];
+                        numerator += w * boundary.values[it - boundary.coords.begin()];
+                        denominator += w;
+                    }
+                    if (denominator > std::numeric_limits<float>::epsilon()) {
+                        volume[shape.index(x, y, z)] = numerator / denominator;
+                    }
+                });
+            }
+        });
+    }
+
+    // Voxels out of reach of every boundary voxel are still holes
+    fillApproximate3DWith(volume, shape, scratch);
+}
+
+} // namespace holefill
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "holefill.h"
+
+namespace holefill {
+
+struct Coord3 {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t z = 0;
+
+    bool operator<(const Coord3& other) const {
+        return (z < other.z) || (z == other.z && (y < other.y || (y == other.y && x < other.x)));
+    }
+};
+
+using WeightFunction3 = std::function<float(const Coord3&, const Coord3&)>;
+
+/**
+ * @brief Fills holes in a volume using a weighted average of all boundary voxels.
+ *
+ * This is the 3D counterpart of fill(). Boundary voxels are the valid voxels with a hole voxel
+ * among their 26 neighbors. For each hole voxel (voxels with negative values) the weighted
+ * average of every boundary voxel is taken. Slabs of the volume are filled in parallel.
+ *
+ * @param volume Pointer to the volume as a flat array of floats, linear values, indexed as
+ *               (z * height + y) * width + x. Negative values indicate holes.
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param depth Depth of the volume in voxels
+ * @param weightFunc Function that calculates the weight between two voxels based on their coordinates.
+ *                   The weight should be higher for closer voxels and lower for distant voxels.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The volume is modified in-place. Scratch memory is proportional to the number of boundary
+ *       voxels plus one bit per voxel; there is no leaner algorithm.
+ *
+ * @see fill for the 2D version
+ */
+void fill3D(float* volume, int32_t width, int32_t height, int32_t depth, WeightFunction3 weightFunc,
+            const FillOptions& options = {});
+
+/**
+ * @brief Fills holes in a volume layer by layer from the boundary inward.
+ *
+ * This is the 3D counterpart of fillApproximate(). Hole voxels are grouped into layers by their
+ * distance from the boundary in the 26-connected sense. Every voxel of a layer is set to the average
+ * of its valid 26 neighbors, which all lie in earlier layers or outside the hole, so the voxels of a
+ * layer are independent of each other and are filled in parallel.
+ *
+ * @param volume Pointer to the volume as a flat array of floats, linear values, indexed as
+ *               (z * height + y) * width + x. Negative values indicate holes.
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param depth Depth of the volume in voxels
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The volume is modified in-place. Scratch memory is proportional to the largest layer. Without
+ *       budget for a layer, the remaining layers are filled by repeated sweeps over the volume instead,
+ *       one layer per sweep, which need no scratch memory; the result is the same.
+ *
+ * @see fillApproximate for the 2D version
+ */
+void fillApproximate3D(float* volume, int32_t width, int32_t height, int32_t depth, const FillOptions& options = {});
+
+/**
+ * @brief Fills holes in a volume using a KD-tree for k-nearest neighbor search.
+ *
+ * This is the 3D counterpart of fillExactWithSearch(). A KD-tree over the boundary voxels finds
+ * the nearestNeighborMax closest boundary voxels of each hole voxel, whose weighted average
+ * replaces the hole voxel. Slabs of the volume are queried in parallel.
+ *
+ * @param volume Pointer to the volume as a flat array of floats, linear values, indexed as
+ *               (z * height + y) * width + x. Negative values indicate holes.
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param depth Depth of the volume in voxels
+ * @param weightFunc Function that calculates the weight between two voxels based on their coordinates.
+ * @param nearestNeighborMax Maximum number of nearest boundary voxels to consider for each hole voxel.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The volume is modified in-place. Scratch memory is the boundary voxels, the KD-tree and
+ *       nearestNeighborMax neighbors per slab. Without budget for the tree, every query scans all
+ *       boundary voxels instead. Of several equally distant voxels the first in the volume are kept,
+ *       so the result depends neither on the tree, nor on its leaf size, tuning().floatTreeLeafSize.
+ *
+ * @see fillExactWithSearch for the 2D version
+ */
+void fillExactWithSearch3D(float* volume, int32_t width, int32_t height, int32_t depth,
+                           WeightFunction3 weightFunc, size_t nearestNeighborMax, const FillOptions& options = {});
+
+/**
+ * @brief Fills holes in a volume by convolving the boundary with a truncated kernel.
+ *
+ * When the weight only depends on the offset between two voxels, the numerator and denominator of
+ * the weighted average are convolutions of the boundary voxels with the kernel. This function
+ * tabulates the kernel once over a cube of the given radius and scatters every boundary voxel into
+ * the hole voxels within that cube. Each thread owns a slab of target voxels, so no two threads
+ * write the same accumulator. Hole voxels farther than radius from every boundary voxel are
+ * filled with fillApproximate3D afterwards.
+ *
+ * Time Complexity: O(m * r^3) where m is the number of boundary voxels and r is the radius,
+ * independent of the number of hole voxels.
+ *
+ * @param volume Pointer to the volume as a flat array of floats, linear values, indexed as
+ *               (z * height + y) * width + x. Negative values indicate holes.
+ * @param width Width of the volume in voxels
+ * @param height Height of the volume in voxels
+ * @param depth Depth of the volume in voxels
+ * @param weightFunc Function that calculates the weight between two voxels. Only evaluated as
+ *                   weightFunc(offset, {0, 0, 0}), so it must be translation invariant.
+ * @param radius Half size of the kernel cube in voxels.
+ * @param options Memory budget and statistics of the call.
+ *
+ * @note The volume is modified in-place. Scratch memory is two floats per hole voxel plus
+ *       one bit per voxel. Without budget for the accumulators, every hole voxel gathers the boundary
+ *       voxels within reach instead, which gives the same result.
+ */
+void fillConvolution3D(float* volume, int32_t width, int32_t height, int32_t depth,
+                       WeightFunction3 weightFunc, int32_t radius, const FillOptions& options = {});
+
+} // namespace holefill
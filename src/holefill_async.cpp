@@ -0,0 +1,148 @@
+#include <exception>
+#include <mutex>
+
+#include "holefill_async.h"
+#include "parallel.h"
+
+namespace holefill {
+
+struct FillOperation::State {
+    Executor executor;
+
+    std::mutex mutex;
+    bool finished = false;
+    std::exception_ptr error;
+    std::coroutine_handle<> awaiting;
+    std::promise<void> promise;
+};
+
+FillOperation::FillOperation(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+bool FillOperation::await_ready() const noexcept {
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    return state->finished;
+}
+
+bool FillOperation::await_suspend(const std::coroutine_handle<> awaiting) {
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->finished) return false;  // Finished in the meantime, do not suspend
+    state->awaiting = awaiting;
+    return true;
+}
+
+void FillOperation::await_resume() const {
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->error) std::rethrow_exception(state->error);
+}
+
+std::future<void> FillOperation::future() {
+    return state->promise.get_future();
+}
+
+bool FillOperation::done() const {
+    const std::lock_guard<std::mutex> lock(state->mutex);
+    return state->finished;
+}
+
+// Runs fill on the thread pool and completes the operation with its outcome
+FillOperation startFill(const std::stop_token& cancel, Executor executor, std::function<void()> fill) {
+    const auto state = std::make_shared<FillOperation::State>();
+    state->executor = std::move(executor);
+
+    submitTask([state, cancel, fill = std::move(fill)] {
+        std::exception_ptr error;
+        try {
+            if (cancel.stop_requested()) throw FillCancelled();
+            fill();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::coroutine_handle<> awaiting;
+        {
+            const std::lock_guard<std::mutex> lock(state->mutex);
+            state->finished = true;
+            state->error = error;
+            awaiting = state->awaiting;
+        }
+        if (error) {
+            state->promise.set_exception(error);
+        } else {
+            state->promise.set_value();
+        }
+
+        if (awaiting) {
+            if (state->executor) {
+                state->executor([awaiting] { awaiting.resume(); });
+            } else {
+                awaiting.resume();
+            }
+        }
+    });
+
+    return FillOperation(state);
+}
+
+FillOperation fillAsync(float* const image, const int32_t width, const int32_t height, WeightFunction weightFunc,
+                        const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fill(image, width, height, weightFunc, options);
+    });
+}
+
+FillOperation fillApproximateAsync(float* const image, const int32_t width, const int32_t height,
+                                   const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillApproximate(image, width, height, options);
+    });
+}
+
+FillOperation fillExactWithSearchAsync(float* const image, const int32_t width, const int32_t height,
+                                       WeightFunction weightFunc, const size_t nearestNeighborMax,
+                                       const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillExactWithSearch(image, width, height, weightFunc, nearestNeighborMax, options);
+    });
+}
+
+FillOperation fillAdaptiveAsync(float* const image, const int32_t width, const int32_t height, WeightFunction weightFunc,
+                                const float tolerance, const int32_t maxCellSize,
+                                const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillAdaptive(image, width, height, weightFunc, tolerance, maxCellSize, options);
+    });
+}
+
+FillOperation fillStochasticAsync(float* const image, const int32_t width, const int32_t height,
+                                  WeightFunction weightFunc, const size_t samplesPerPixel, float* const variance,
+                                  const uint64_t seed, const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillStochastic(image, width, height, weightFunc, samplesPerPixel, variance, seed, options);
+    });
+}
+
+FillOperation fillExactWithDualTreeSearchAsync(float* const image, const int32_t width, const int32_t height,
+                                               WeightFunction weightFunc, const size_t nearestNeighborMax,
+                                               const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillExactWithDualTreeSearch(image, width, height, weightFunc, nearestNeighborMax, options);
+    });
+}
+
+FillOperation fillMultiresolutionAsync(float* const image, const int32_t width, const int32_t height,
+                                       WeightFunction weightFunc, const int32_t factor, const float bandTolerance,
+                                       const FillOptions& options, Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillMultiresolution(image, width, height, weightFunc, factor, bandTolerance, options);
+    });
+}
+
+FillOperation fillHybridAsync(float* const image, const int32_t width, const int32_t height, WeightFunction weightFunc,
+                              const float tolerance, const int32_t tileSize, const FillOptions& options,
+                              Executor executor) {
+    return startFill(options.cancel, std::move(executor), [=] {
+        fillHybrid(image, width, height, weightFunc, tolerance, tileSize, options);
+    });
+}
+
+} // namespace holefill
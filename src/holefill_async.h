@@ -0,0 +1,112 @@
+#pragma once
+
+#include <coroutine>
+#include <functional>
+#include <future>
+#include <memory>
+
+#include "holefill.h"
+
+namespace holefill {
+
+/**
+ * @brief Runs a function on the thread of the caller's choice, e.g. by posting it to an event loop.
+ */
+using Executor = std::function<void(std::function<void()>)>;
+
+/**
+ * @brief A fill running on the library's thread pool.
+ *
+ * The fill starts as soon as the operation is created. co_await the operation to suspend the
+ * awaiting coroutine until the fill has finished; it is resumed through the executor given to the
+ * fillAsync function, or on the pool thread that ran the fill when no executor was given. Awaiting
+ * rethrows the exception of the fill, e.g. FillCancelled or MemoryBudgetExceeded.
+ *
+ * Code that does not use coroutines can call future() instead.
+ *
+ * @note The image and the weight function must stay alive until the fill has finished.
+ */
+class FillOperation {
+public:
+    struct State;
+
+    explicit FillOperation(std::shared_ptr<State> state);
+
+    bool await_ready() const noexcept;
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    void await_resume() const;
+
+    /**
+     * @brief Returns a future that becomes ready when the fill has finished. May be called once.
+     */
+    std::future<void> future();
+
+    /**
+     * @brief Returns whether the fill has finished, successfully or not.
+     */
+    bool done() const;
+
+private:
+    std::shared_ptr<State> state;
+};
+
+/**
+ * @brief Starts fill on the library's thread pool, see FillOperation.
+ *
+ * Cancel through FillOptions::cancel: a fill cancelled before it starts leaves the image untouched,
+ * a running one stops at its next check and leaves the pixels it has not filled yet negative.
+ *
+ * @param executor Where the awaiting coroutine is resumed, or empty to resume it on the pool thread
+ */
+FillOperation fillAsync(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                        const FillOptions& options = {}, Executor executor = {});
+
+/**
+ * @brief Starts fillApproximate on the library's thread pool, see fillAsync.
+ */
+FillOperation fillApproximateAsync(float* image, int32_t width, int32_t height,
+                                   const FillOptions& options = {}, Executor executor = {});
+
+/**
+ * @brief Starts fillExactWithSearch on the library's thread pool, see fillAsync.
+ */
+FillOperation fillExactWithSearchAsync(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                                       size_t nearestNeighborMax, const FillOptions& options = {},
+                                       Executor executor = {});
+
+/**
+ * @brief Starts fillAdaptive on the library's thread pool, see fillAsync.
+ */
+FillOperation fillAdaptiveAsync(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                                float tolerance = 1.0e-3f, int32_t maxCellSize = 32,
+                                const FillOptions& options = {}, Executor executor = {});
+
+/**
+ * @brief Starts fillStochastic on the library's thread pool, see fillAsync.
+ */
+FillOperation fillStochasticAsync(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                                  size_t samplesPerPixel, float* variance = nullptr, uint64_t seed = 0,
+                                  const FillOptions& options = {}, Executor executor = {});
+
+/**
+ * @brief Starts fillExactWithDualTreeSearch on the library's thread pool, see fillAsync.
+ */
+FillOperation fillExactWithDualTreeSearchAsync(float* image, int32_t width, int32_t height,
+                                               WeightFunction weightFunc, size_t nearestNeighborMax,
+                                               const FillOptions& options = {}, Executor executor = {});
+
+/**
+ * @brief Starts fillMultiresolution on the library's thread pool, see fillAsync.
+ */
+FillOperation fillMultiresolutionAsync(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                                       int32_t factor = 2, float bandTolerance = 0.1f,
+                                       const FillOptions& options = {}, Executor executor = {});
+
+/**
+ * @brief Starts fillHybrid on the library's thread pool, see fillAsync. Its report is not kept.
+ */
+FillOperation fillHybridAsync(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                              float tolerance = 1.0e-2f, int32_t tileSize = 16,
+                              const FillOptions& options = {}, Executor executor = {});
+
+} // namespace holefill
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "holefill_batch.h"
+#include "holespans.h"
+#include "parallel.h"
+
+namespace holefill {
+
+const char* fillMethodName(const FillMethod method) {
+    switch (method) {
+        case FillMethod::Exact: return "exact";
+        case FillMethod::Approximate: return "approx";
+        case FillMethod::Search: return "search";
+        case FillMethod::Adaptive: return "adaptive";
+        case FillMethod::Stochastic: return "stochastic";
+        case FillMethod::DualTree: return "dualtree";
+        case FillMethod::Multiresolution: return "multires";
+        case FillMethod::Hybrid: return "hybrid";
+    }
+    return "unknown";
+}
+
+// Relative cost of a job: hole pixels times the boundary work each of them does. Every run of holes
+// has two ends and is bordered above and below, so four boundary pixels per run is a fair estimate.
+double estimateJobCost(const FillJob& job) {
+    const HoleSpans holes(job.image, job.width, job.height);
+    const double holeCount = static_cast<double>(holes.pixelCount);
+    const double boundary = 4.0 * static_cast<double>(holes.spans.size());
+
+    switch (job.method) {
+        case FillMethod::Approximate:
+            return holeCount;
+        case FillMethod::Search:
+        case FillMethod::DualTree:
+            return holeCount * static_cast<double>(job.nearestNeighborMax) * std::log2(boundary + 2.0);
+        case FillMethod::Stochastic:
+            return holeCount * static_cast<double>(job.samplesPerPixel);
+        case FillMethod::Multiresolution:
+            // The band stays exact, the reduced fill has factor² fewer holes and factor fewer boundary pixels
+            return holeCount * boundary / static_cast<double>(std::max(1, job.factor));
+        case FillMethod::Exact:
+        case FillMethod::Adaptive:
+        case FillMethod::Hybrid:
+            break;
+    }
+    return holeCount * boundary;
+}
+
+void runFillJob(const FillJob& job) {
+    switch (job.method) {
+        case FillMethod::Exact:
+            fill(job.image, job.width, job.height, job.weightFunc, job.options);
+            break;
+        case FillMethod::Approximate:
+            fillApproximate(job.image, job.width, job.height, job.options);
+            break;
+        case FillMethod::Search:
+            fillExactWithSearch(job.image, job.width, job.height, job.weightFunc, job.nearestNeighborMax, job.options);
+            break;
+        case FillMethod::Adaptive:
+            fillAdaptive(job.image, job.width, job.height, job.weightFunc, job.tolerance, job.maxCellSize, job.options);
+            break;
+        case FillMethod::Stochastic:
+            fillStochastic(job.image, job.width, job.height, job.weightFunc, job.samplesPerPixel, job.variance,
+                           job.seed, job.options);
+            break;
+        case FillMethod::DualTree:
+            fillExactWithDualTreeSearch(job.image, job.width, job.height, job.weightFunc, job.nearestNeighborMax,
+                                        job.options);
+            break;
+        case FillMethod::Multiresolution:
+            fillMultiresolution(job.image, job.width, job.height, job.weightFunc, job.factor, job.bandTolerance,
+                                job.options);
+            break;
+        case FillMethod::Hybrid:
+            fillHybrid(job.image, job.width, job.height, job.weightFunc, job.refineTolerance, job.tileSize, job.options);
+            break;
+    }
+}
+
+// Runs the job's engine and records its exception instead of letting it escape
+void runJob(FillJob& job) {
+    try {
+        runFillJob(job);
+        job.error = nullptr;
+    } catch (...) {
+        job.error = std::current_exception();
+    }
+}
+
+// Estimates the cost of a job, recording invalid jobs and failures such as bad_alloc in its error
+// so that the job is skipped instead of failing the batch
+double estimateJob(FillJob& job) {
+    try {
+        job.error = nullptr;
+        if (!job.image || job.width <= 0 || job.height <= 0) {
+            throw std::invalid_argument("FillJob needs an image of positive width and height");
+        }
+        return estimateJobCost(job);
+    } catch (...) {
+        job.error = std::current_exception();
+        return 0.0;
+    }
+}
+
+void fillBatch(const std::span<FillJob> jobs) {
+    std::vector<double> costs(jobs.size());
+    parallelFor(jobs.size(), [&](const size_t i) {
+        SerialScope serial;
+        costs[i] = estimateJob(jobs[i]);
+    });
+
+    std::vector<size_t> order;
+    order.reserve(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!jobs[i].error) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return costs[a] > costs[b]; });
+
+    // A job is large when running it whole on one thread could keep the others waiting: with a
+    // quarter of a thread's share of the batch it still balances well among the small ones
+    const double threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const double largeCost = std::accumulate(costs.begin(), costs.end(), 0.0) / (4.0 * threadCount);
+    const auto firstSmall = threadCount > 1.0
+        ? std::find_if(order.begin(), order.end(), [&](const size_t i) { return costs[i] <= largeCost; })
+        : order.begin();
+
+    for (auto it = order.begin(); it != firstSmall; ++it) runJob(jobs[*it]);
+
+    // Indices are handed out in order, so the most expensive small jobs start first
+    const std::span<const size_t> small(firstSmall, order.end());
+    parallelFor(small.size(), [&](const size_t n) {
+        SerialScope serial;
+        runJob(jobs[small[n]]);
+    });
+}
+
+} // namespace holefill
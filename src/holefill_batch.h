@@ -0,0 +1,91 @@
+#pragma once
+
+#include <exception>
+#include <span>
+
+#include "holefill.h"
+
+namespace holefill {
+
+/**
+ * @brief Engine a FillJob runs, one per 2D fill function.
+ */
+enum class FillMethod {
+    Exact,        ///< fill
+    Approximate,  ///< fillApproximate
+    Search,       ///< fillExactWithSearch
+    Adaptive,     ///< fillAdaptive
+    Stochastic,   ///< fillStochastic
+    DualTree,     ///< fillExactWithDualTreeSearch
+    Multiresolution, ///< fillMultiresolution
+    Hybrid        ///< fillHybrid
+};
+
+/**
+ * @brief Returns the name of an engine as the CLI spells it, e.g. "search" or "approx".
+ */
+const char* fillMethodName(FillMethod method);
+
+/**
+ * @brief One image of a fillBatch call together with the engine and parameters to fill it with.
+ *
+ * Parameters an engine does not take are ignored; their defaults match those of the fill functions.
+ */
+struct FillJob {
+    float* image = nullptr;
+    int32_t width = 0;
+    int32_t height = 0;
+    FillMethod method = FillMethod::Search;
+    /// Weight function of every engine except Approximate
+    WeightFunction weightFunc;
+    /// Search and DualTree
+    size_t nearestNeighborMax = 100;
+    /// Adaptive
+    float tolerance = 1.0e-3f;
+    int32_t maxCellSize = 32;
+    /// Stochastic
+    size_t samplesPerPixel = 64;
+    float* variance = nullptr;
+    uint64_t seed = 0;
+    /// Multiresolution
+    int32_t factor = 2;
+    float bandTolerance = 0.1f;
+    /// Hybrid
+    float refineTolerance = 1.0e-2f;
+    int32_t tileSize = 16;
+    FillOptions options;
+    /// Output: the exception the fill threw, e.g. MemoryBudgetExceeded, or null on success
+    std::exception_ptr error;
+};
+
+/**
+ * @brief Fills the image of one job with its engine and parameters.
+ *
+ * Exceptions of the engine propagate; FillJob::error is left untouched.
+ */
+void runFillJob(const FillJob& job);
+
+/**
+ * @brief Fills every image of a batch, keeping the library's thread pool busy across jobs.
+ *
+ * Running thousands of small fills one after another leaves most threads idle, because each of
+ * them is too small to split well. This function works as follows:
+ * 1. Estimates the cost of every job from its hole pixel count and its number of runs of holes,
+ *    which stands in for the boundary length, weighted by the engine's cost per hole pixel
+ * 2. Runs jobs costing more than a share of the whole batch one at a time, each split over the
+ *    thread pool as by the plain fill functions
+ * 3. Runs the remaining jobs whole, one per thread, starting with the most expensive so that the
+ *    last jobs to finish are short ones
+ *
+ * All jobs share the thread pool and the instruction set kernels chosen at startup. Results are
+ * the same as filling each job on its own with the same options.
+ *
+ * @param jobs The jobs to run. Failures are stored in FillJob::error; the other jobs still run. Jobs
+ *             without an image or with a width or height below 1 fail with std::invalid_argument
+ *             before any job runs.
+ *
+ * @note The weight functions must be safe to call concurrently, also across jobs that share one.
+ */
+void fillBatch(std::span<FillJob> jobs);
+
+} // namespace holefill
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+#include "holefill_mask.h"
+#include "holespans.h"
+#include "kernels.h"
+#include "parallel.h"
+
+namespace holefill {
+
+// Rows handed to a task at a time by the row-parallel steps
+constexpr int32_t maskRowsPerTask = 32;
+
+// Columns of words handed to a task at a time by dilateColumns
+constexpr size_t maskWordsPerStrip = 8;
+
+// Calls body(y0, y1) for blocks of rows in parallel
+template <typename Body>
+void forEachRowBlock(const int32_t height, const Body& body) {
+    const size_t blocks = static_cast<size_t>((height + maskRowsPerTask - 1) / maskRowsPerTask);
+    parallelFor(blocks, [&](const size_t b) {
+        const int32_t y0 = static_cast<int32_t>(b) * maskRowsPerTask;
+        body(y0, std::min(height, y0 + maskRowsPerTask));
+    });
+}
+
+// dst bit x = src bit x + n, i.e. bits move towards the start of the row and zeros enter at its end
+void shiftTowardsStart(const uint64_t* const src, uint64_t* const dst, const size_t words, const size_t n) {
+    const size_t wordShift = n / 64;
+    const size_t bitShift = n % 64;
+    for (size_t i = 0; i < words; ++i) {
+        const uint64_t low = i + wordShift < words ? src[i + wordShift] : 0;
+        const uint64_t high = i + wordShift + 1 < words ? src[i + wordShift + 1] : 0;
+        dst[i] = bitShift ? (low >> bitShift) | (high << (64 - bitShift)) : low;
+    }
+}
+
+// dst bit x = src bit x - n, i.e. bits move towards the end of the row and zeros enter at its start
+void shiftTowardsEnd(const uint64_t* const src, uint64_t* const dst, const size_t words, const size_t n) {
+    const size_t wordShift = n / 64;
+    const size_t bitShift = n % 64;
+    for (size_t i = 0; i < words; ++i) {
+        const uint64_t high = i >= wordShift ? src[i - wordShift] : 0;
+        const uint64_t low = i >= wordShift + 1 ? src[i - wordShift - 1] : 0;
+        dst[i] = bitShift ? (high << bitShift) | (low >> (64 - bitShift)) : high;
+    }
+}
+
+// Ors into every bit of run the next length - 1 bits in the direction shift moves them from, doubling
+// the covered length per step. The window may overlap itself on the last step, which ors are immune to.
+template <typename Shift>
+void orWindow(uint64_t* const run, uint64_t* const scratch, const size_t words, const size_t length, const Shift& shift) {
+    size_t covered = 1;
+    while (covered < length) {
+        const size_t step = std::min(covered, length - covered);
+        shift(run, scratch, words, step);
+        for (size_t i = 0; i < words; ++i) run[i] |= scratch[i];
+        covered += step;
+    }
+}
+
+// First position at or after x whose bit equals set, or words * 64 if there is none
+size_t findBit(const uint64_t* const row, const size_t words, const size_t x, const bool set) {
+    size_t w = x / 64;
+    if (w >= words) return words * 64;
+    uint64_t word = (set ? row[w] : ~row[w]) & (~uint64_t{0} << (x % 64));
+    while (!word) {
+        if (++w == words) return words * 64;
+        word = set ? row[w] : ~row[w];
+    }
+    return w * 64 + static_cast<size_t>(std::countr_zero(word));
+}
+
+// Calls visit(x0, x1) for every run [x0, x1) of set bits of a row
+template <typename Visit>
+void forEachRun(const uint64_t* const row, const size_t words, const int32_t width, const Visit& visit) {
+    for (size_t x = findBit(row, words, 0, true); x < static_cast<size_t>(width);) {
+        const size_t end = std::min<size_t>(findBit(row, words, x, false), width);
+        visit(static_cast<int32_t>(x), static_cast<int32_t>(end));
+        x = findBit(row, words, end, true);
+    }
+}
+
+void clearBits(uint64_t* const row, const int32_t x0, const int32_t x1) {
+    for (int32_t x = x0; x < x1;) {
+        const int32_t bit = x & 63;
+        const int32_t count = std::min(64 - bit, x1 - x);
+        const uint64_t bits = count == 64 ? ~uint64_t{0} : ((uint64_t{1} << count) - 1) << bit;
+        row[x >> 6] &= ~bits;
+        x += count;
+    }
+}
+
+HoleMask::HoleMask(const int32_t width, const int32_t height)
+    : width_(width), height_(height), wordsPerRow_((static_cast<size_t>(width) + 63) / 64),
+      bits(wordsPerRow_ * height, 0) {}
+
+HoleMask HoleMask::threshold(const uint8_t* const pixels, const int32_t width, const int32_t height,
+                             const uint8_t level) {
+    HoleMask mask(width, height);
+    const Kernels& k = kernels();
+    forEachRowBlock(height, [&](const int32_t y0, const int32_t y1) {
+        for (int32_t y = y0; y < y1; ++y) {
+            k.thresholdBits(pixels + static_cast<size_t>(y) * width, width, level, mask.row(y));
+        }
+    });
+    return mask;
+}
+
+size_t HoleMask::count() const {
+    size_t holes = 0;
+    for (const uint64_t word : bits) holes += std::popcount(word);
+    return holes;
+}
+
+void HoleMask::clearPadding() {
+    if (width_ % 64 == 0) return;
+    const uint64_t valid = (uint64_t{1} << (width_ % 64)) - 1;
+    for (int32_t y = 0; y < height_; ++y) row(y)[wordsPerRow_ - 1] &= valid;
+}
+
+void HoleMask::invert() {
+    for (uint64_t& word : bits) word = ~word;
+    clearPadding();
+}
+
+void HoleMask::dilate(int32_t radius) {
+    radius = std::min(radius, std::max(width_, height_));
+    if (radius <= 0 || bits.empty()) return;
+    dilateRows(radius);
+    dilateColumns(radius);
+}
+
+void HoleMask::erode(const int32_t radius) {
+    if (radius <= 0 || bits.empty()) return;
+
+    // Zeros enter the complement at the image border, which leaves the border itself a hole
+    invert();
+    dilate(radius);
+    invert();
+}
+
+// Every pixel becomes the or of the r pixels on either side of it. Windows towards the start and
+// towards the end are built separately, so neither reaches past the row and loses its edge.
+void HoleMask::dilateRows(const int32_t radius) {
+    const size_t words = wordsPerRow_;
+    forEachRowBlock(height_, [&](const int32_t y0, const int32_t y1) {
+        std::vector<uint64_t> towardsStart(words), towardsEnd(words), scratch(words);
+        for (int32_t y = y0; y < y1; ++y) {
+            uint64_t* const bitsOfRow = row(y);
+            std::copy(bitsOfRow, bitsOfRow + words, towardsStart.begin());
+            std::copy(bitsOfRow, bitsOfRow + words, towardsEnd.begin());
+            orWindow(towardsStart.data(), scratch.data(), words, static_cast<size_t>(radius) + 1, shiftTowardsStart);
+            orWindow(towardsEnd.data(), scratch.data(), words, static_cast<size_t>(radius) + 1, shiftTowardsEnd);
+            for (size_t i = 0; i < words; ++i) bitsOfRow[i] = towardsStart[i] | towardsEnd[i];
+        }
+    });
+    clearPadding();
+}
+
+// van Herk/Gil-Werman over the rows of every column of words: with the column padded by radius
+// empty rows at either end and cut into blocks of the window length, a window is the suffix or of
+// the block it starts in joined with the prefix or of the block it ends in. Three ors per word
+// whatever the radius, and 64 pixel columns per or.
+void HoleMask::dilateColumns(const int32_t radius) {
+    const size_t window = 2 * static_cast<size_t>(radius) + 1;
+    const size_t padded = static_cast<size_t>(height_) + 2 * radius;
+    const size_t strips = (wordsPerRow_ + maskWordsPerStrip - 1) / maskWordsPerStrip;
+
+    parallelFor(strips, [&](const size_t strip) {
+        const size_t c0 = strip * maskWordsPerStrip;
+        const size_t n = std::min(maskWordsPerStrip, wordsPerRow_ - c0);
+        std::vector<uint64_t> prefix(padded * n), suffix(padded * n);
+
+        const auto padRow = [&](const size_t i) -> const uint64_t* {
+            return (i >= static_cast<size_t>(radius) && i - radius < static_cast<size_t>(height_))
+                ? row(static_cast<int32_t>(i - radius)) + c0
+                : nullptr;
+        };
+
+        for (size_t i = 0; i < padded; ++i) {
+            const uint64_t* const source = padRow(i);
+            uint64_t* const out = &prefix[i * n];
+            const bool blockStart = i % window == 0;
+            for (size_t j = 0; j < n; ++j) {
+                const uint64_t value = source ? source[j] : 0;
+                out[j] = blockStart ? value : prefix[(i - 1) * n + j] | value;
+            }
+        }
+        for (size_t i = padded; i-- > 0;) {
+            const uint64_t* const source = padRow(i);
+            uint64_t* const out = &suffix[i * n];
+            const bool blockEnd = i % window == window - 1 || i == padded - 1;
+            for (size_t j = 0; j < n; ++j) {
+                const uint64_t value = source ? source[j] : 0;
+                out[j] = blockEnd ? value : suffix[(i + 1) * n + j] | value;
+            }
+        }
+
+        // The window of row y covers padded rows [y, y + window)
+        for (int32_t y = 0; y < height_; ++y) {
+            uint64_t* const out = row(y) + c0;
+            for (size_t j = 0; j < n; ++j) out[j] = suffix[y * n + j] | prefix[(y + window - 1) * n + j];
+        }
+    });
+}
+
+// Runs of holes are labeled with a union-find over the runs of adjacent rows, so the work grows
+// with the number of runs rather than with the number of pixels
+void HoleMask::removeComponentsSmallerThan(const size_t minArea) {
+    if (minArea <= 1 || bits.empty()) return;
+
+    // Runs of every row, counted first so they are stored in one array
+    std::vector<size_t> rowStart(static_cast<size_t>(height_) + 1, 0);
+    forEachRowBlock(height_, [&](const int32_t y0, const int32_t y1) {
+        for (int32_t y = y0; y < y1; ++y) {
+            size_t count = 0;
+            forEachRun(row(y), wordsPerRow_, width_, [&](int32_t, int32_t) { ++count; });
+            rowStart[y + 1] = count;
+        }
+    });
+    std::partial_sum(rowStart.begin(), rowStart.end(), rowStart.begin());
+
+    std::vector<HoleSpan> runs(rowStart.back());
+    forEachRowBlock(height_, [&](const int32_t y0, const int32_t y1) {
+        for (int32_t y = y0; y < y1; ++y) {
+            size_t next = rowStart[y];
+            forEachRun(row(y), wordsPerRow_, width_, [&](const int32_t x0, const int32_t x1) { runs[next++] = {y, x0, x1}; });
+        }
+    });
+
+    std::vector<uint32_t> labels;
+    std::vector<size_t> area(labelSpanComponents(runs, labels), 0);
+    for (size_t i = 0; i < runs.size(); ++i) area[labels[i]] += static_cast<size_t>(runs[i].x1 - runs[i].x0);
+
+    forEachRowBlock(height_, [&](const int32_t y0, const int32_t y1) {
+        for (int32_t y = y0; y < y1; ++y) {
+            for (size_t i = rowStart[y]; i < rowStart[y + 1]; ++i) {
+                if (area[labels[i]] < minArea) clearBits(row(y), runs[i].x0, runs[i].x1);
+            }
+        }
+    });
+}
+
+void HoleMask::applyTo(float* const image) const {
+    forEachRowBlock(height_, [&](const int32_t y0, const int32_t y1) {
+        for (int32_t y = y0; y < y1; ++y) {
+            float* const pixels = image + static_cast<size_t>(y) * width_;
+            const uint64_t* const words = row(y);
+            for (size_t w = 0; w < wordsPerRow_; ++w) {
+                for (uint64_t word = words[w]; word; word &= word - 1) {
+                    pixels[w * 64 + static_cast<size_t>(std::countr_zero(word))] = -1.0f;
+                }
+            }
+        }
+    });
+}
+
+} // namespace holefill
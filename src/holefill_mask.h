@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace holefill {
+
+/**
+ * @brief Hole mask packed as one bit per pixel, with the clean-up steps commonly applied to masks before a fill.
+ *
+ * Every row starts on a 64-bit word, bit x % 64 of word x / 64 being pixel x. All steps work on whole
+ * words and run in parallel over rows or columns of words, so a mask of a large image is prepared in a
+ * few passes over an eighth of a byte per pixel, without a float mask ever being built.
+ *
+ * @code
+ * holefill::HoleMask mask = holefill::HoleMask::threshold(maskPixels, width, height, 128);
+ * mask.removeComponentsSmallerThan(16);
+ * mask.dilate(2);
+ * mask.applyTo(image);
+ * holefill::fill(image, width, height, weightFunc);
+ * @endcode
+ */
+class HoleMask {
+public:
+    /**
+     * @brief Mask of the given size without holes.
+     */
+    HoleMask(int32_t width, int32_t height);
+
+    /**
+     * @brief Marks the pixels of an 8-bit mask whose value is below level as holes.
+     *
+     * Uses the instruction set kernels of the fill engines.
+     *
+     * @param pixels width * height values in row-major order
+     */
+    static HoleMask threshold(const uint8_t* pixels, int32_t width, int32_t height, uint8_t level);
+
+    int32_t width() const { return width_; }
+    int32_t height() const { return height_; }
+    size_t wordsPerRow() const { return wordsPerRow_; }
+
+    const uint64_t* row(const int32_t y) const { return bits.data() + static_cast<size_t>(y) * wordsPerRow_; }
+    uint64_t* row(const int32_t y) { return bits.data() + static_cast<size_t>(y) * wordsPerRow_; }
+
+    bool hole(const int32_t x, const int32_t y) const { return (row(y)[x >> 6] >> (x & 63)) & 1u; }
+
+    /**
+     * @brief Number of hole pixels.
+     */
+    size_t count() const;
+
+    /**
+     * @brief Grows the holes by radius pixels in every direction, i.e. by a (2 * radius + 1) square.
+     *
+     * Rows are dilated by shifting whole words, doubling the covered width each time; columns of words
+     * use the van Herk/Gil-Werman running maximum, whose cost does not depend on the radius.
+     */
+    void dilate(int32_t radius);
+
+    /**
+     * @brief Shrinks the holes by radius pixels in every direction, as the dual of dilate().
+     *
+     * Pixels outside the image count as holes, so holes touching the image border do not shrink from it.
+     */
+    void erode(int32_t radius);
+
+    /**
+     * @brief Removes every 8-connected hole component of fewer than minArea pixels, e.g. speckles of a noisy mask.
+     */
+    void removeComponentsSmallerThan(size_t minArea);
+
+    /**
+     * @brief Marks the holes in image, a width * height float image, by writing -1 at every hole pixel.
+     *
+     * Other pixels are left untouched. Rows without holes are passed over a word at a time.
+     */
+    void applyTo(float* image) const;
+
+private:
+    int32_t width_;
+    int32_t height_;
+    size_t wordsPerRow_;
+    std::vector<uint64_t> bits;
+
+    // Zeroes the bits past the last pixel of every row
+    void clearPadding();
+    void dilateRows(int32_t radius);
+    void dilateColumns(int32_t radius);
+    void invert();
+};
+
+} // namespace holefill
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "holefill_plan.h"
+#include "holespans.h"
+#include "parallel.h"
+
+namespace holefill {
+
+// Hole pixels at which the candidates are compared with fill(): planDepthSamples from the centre to
+// the edge of each of the largest components, the rest spread evenly over all holes
+constexpr size_t planSampleCount = 48;
+constexpr size_t planDepthSamples = 4;
+constexpr size_t planProfiledComponents = 8;
+
+// Values of k tried for the k-NN engines and of samplesPerPixel tried for fillStochastic
+constexpr std::array<size_t, 7> planNeighborCounts = {4, 8, 16, 32, 64, 128, 256};
+constexpr std::array<size_t, 5> planSamplesPerPixel = {16, 32, 64, 128, 256};
+
+// The samples rarely hit the pixel where the k-NN engines are furthest from fill(), so the largest
+// difference found is taken this many times over
+constexpr double nearestErrorMargin = 2.0;
+
+// fillStochastic is taken to stay within three standard errors of fill()
+constexpr double stochasticErrorDeviations = 3.0;
+
+// Differences from fill() at one sampled hole pixel
+struct SampleErrors {
+    // Of the weighted average of the k nearest boundary pixels, for each of planNeighborCounts
+    std::array<double, planNeighborCounts.size()> nearest{};
+    // Sums of the weights of those pixels
+    std::array<double, planNeighborCounts.size()> nearestDenominators{};
+    // Weighted standard deviation of the boundary values, the spread fillStochastic samples from
+    double spread = 0.0;
+    // fill() result and the sum of weights behind it
+    double value = 0.0;
+    double denominator = 0.0;
+};
+
+// Same fallback as the engines when the weights vanish
+inline double averageOrZero(const double numerator, const double denominator) {
+    return denominator > std::numeric_limits<float>::epsilon() ? numerator / denominator : 0.0;
+}
+
+SampleErrors measureSample(const float* const image, const int32_t width, const Coord& u,
+                           const std::pmr::vector<Coord>& boundaryPixels, const WeightFunction& weightFunc) {
+    const size_t m = boundaryPixels.size();
+    std::vector<float> weights(m);
+    std::vector<int64_t> distances(m);
+    double numerator = 0.0;
+    double denominator = 0.0;
+    for (size_t i = 0; i < m; ++i) {
+        const Coord& v = boundaryPixels[i];
+        const int64_t dx = v.x - u.x;
+        const int64_t dy = v.y - u.y;
+        distances[i] = dx * dx + dy * dy;
+        weights[i] = weightFunc(u, v);
+        numerator += static_cast<double>(weights[i]) * image[static_cast<size_t>(v.y) * width + v.x];
+        denominator += weights[i];
+    }
+    const double exact = averageOrZero(numerator, denominator);
+
+    SampleErrors errors;
+    errors.value = exact;
+    errors.denominator = denominator;
+    double squares = 0.0;
+    for (size_t i = 0; i < m; ++i) {
+        const Coord& v = boundaryPixels[i];
+        const double deviation = image[static_cast<size_t>(v.y) * width + v.x] - exact;
+        squares += weights[i] * deviation * deviation;
+    }
+    errors.spread = std::sqrt(averageOrZero(squares, denominator));
+
+    // Only the nearest planNeighborCounts.back() pixels are ever summed, so only they are sorted
+    std::vector<uint32_t> order(m);
+    std::iota(order.begin(), order.end(), 0u);
+    const size_t nearest = std::min(m, planNeighborCounts.back());
+    std::partial_sort(order.begin(), order.begin() + nearest, order.end(),
+                      [&](const uint32_t a, const uint32_t b) { return distances[a] < distances[b]; });
+
+    double nearestNumerator = 0.0;
+    double nearestDenominator = 0.0;
+    size_t summed = 0;
+    errors.nearestDenominators.fill(denominator);
+    for (size_t c = 0; c < planNeighborCounts.size(); ++c) {
+        // With k at least the boundary size the k-NN engines sum the whole boundary, i.e. equal fill()
+        if (planNeighborCounts[c] >= m) break;
+        for (; summed < planNeighborCounts[c]; ++summed) {
+            const Coord& v = boundaryPixels[order[summed]];
+            nearestNumerator += static_cast<double>(weights[order[summed]]) * image[static_cast<size_t>(v.y) * width + v.x];
+            nearestDenominator += weights[order[summed]];
+        }
+        errors.nearest[c] = std::abs(averageOrZero(nearestNumerator, nearestDenominator) - exact);
+        errors.nearestDenominators[c] = nearestDenominator;
+    }
+    return errors;
+}
+
+// Bounding box and size of one component of the holes
+struct ComponentExtent {
+    int32_t x0 = std::numeric_limits<int32_t>::max();
+    int32_t y0 = std::numeric_limits<int32_t>::max();
+    int32_t x1 = std::numeric_limits<int32_t>::min();
+    int32_t y1 = std::numeric_limits<int32_t>::min();
+    size_t area = 0;
+};
+
+// Hole pixels on the row through the centre of each of the largest components, from its centre
+// towards its edge, then hole pixels evenly spaced in row-major order: planSampleCount in all, or
+// every hole pixel if there are fewer. The depth profiles catch errors that only appear some
+// distance into a hole, e.g. where the weights of the nearest pixels vanish but those of the whole
+// boundary do not.
+std::vector<Coord> pickSamples(const HoleSpans& holes, const std::vector<uint32_t>& labels,
+                               const std::vector<ComponentExtent>& components, size_t& profiles) {
+    std::vector<Coord> samples;
+    profiles = 0;
+    if (holes.pixelCount <= planSampleCount) {
+        holes.forEachPixel([&](const int32_t x, const int32_t y) { samples.push_back({x, y}); });
+        return samples;
+    }
+
+    std::vector<uint32_t> bySize(components.size());
+    std::iota(bySize.begin(), bySize.end(), 0u);
+    const size_t profiled = std::min(components.size(), planProfiledComponents);
+    std::partial_sort(bySize.begin(), bySize.begin() + profiled, bySize.end(),
+                      [&](const uint32_t a, const uint32_t b) { return components[a].area > components[b].area; });
+
+    constexpr uint32_t unsampled = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> slotOf(components.size(), unsampled);
+    for (size_t s = 0; s < profiled; ++s) slotOf[bySize[s]] = static_cast<uint32_t>(s);
+
+    // Span of each profiled component nearest its centre, and the pixel of it nearest the centre
+    std::vector<const HoleSpan*> centreSpans(profiled, nullptr);
+    std::vector<int32_t> centreX(profiled);
+    std::vector<int64_t> centreDistances(profiled, std::numeric_limits<int64_t>::max());
+    for (size_t i = 0; i < holes.spans.size(); ++i) {
+        const uint32_t slot = slotOf[labels[i]];
+        if (slot == unsampled) continue;
+        const HoleSpan& span = holes.spans[i];
+        const ComponentExtent& extent = components[labels[i]];
+        const int32_t cx = extent.x0 + (extent.x1 - extent.x0) / 2;
+        const int32_t cy = extent.y0 + (extent.y1 - extent.y0) / 2;
+        const int32_t x = std::clamp(cx, span.x0, span.x1 - 1);
+        const int64_t dx = x - cx;
+        const int64_t dy = span.y - cy;
+        if (dx * dx + dy * dy < centreDistances[slot]) {
+            centreDistances[slot] = dx * dx + dy * dy;
+            centreSpans[slot] = &span;
+            centreX[slot] = x;
+        }
+    }
+    profiles = profiled;
+    for (size_t slot = 0; slot < profiled; ++slot) {
+        const HoleSpan& span = *centreSpans[slot];
+        const int32_t edge = (centreX[slot] - span.x0 >= span.x1 - 1 - centreX[slot]) ? span.x0 : span.x1 - 1;
+        for (size_t d = 0; d < planDepthSamples; ++d) {
+            const int32_t x = centreX[slot] + static_cast<int32_t>((edge - centreX[slot]) * static_cast<int64_t>(d) /
+                                                                   static_cast<int64_t>(planDepthSamples - 1));
+            samples.push_back({x, span.y});
+        }
+    }
+
+    // Targets are increasing, so one pass over the spans finds them all
+    const size_t spaced = planSampleCount - samples.size();
+    size_t next = 0;
+    size_t before = 0;
+    for (const HoleSpan& span : holes.spans) {
+        const size_t length = static_cast<size_t>(span.x1 - span.x0);
+        while (next < spaced) {
+            const size_t target = (2 * next + 1) * holes.pixelCount / (2 * spaced);
+            if (target >= before + length) break;
+            samples.push_back({span.x0 + static_cast<int32_t>(target - before), span.y});
+            ++next;
+        }
+        before += length;
+    }
+    return samples;
+}
+
+// One engine and parameters considered by the planner
+struct PlanCandidate {
+    FillMethod method;
+    size_t nearestNeighborMax = 0;
+    size_t samplesPerPixel = 0;
+    double seconds = 0.0;
+    double error = 0.0;
+};
+
+FillPlan planFill(const float* const image, const int32_t width, const int32_t height,
+                  const WeightFunction& weightFunc, const FillTarget& target) {
+    const auto start = std::chrono::steady_clock::now();
+    const Tuning& model = tuning();
+    FillPlan plan;
+
+    const HoleSpans holes(image, width, height);
+    const std::pmr::vector<Coord> boundaryPixels = findBoundaryPixels(image, width, height, holes,
+                                                                       std::pmr::get_default_resource());
+    plan.holePixels = holes.pixelCount;
+    plan.boundaryPixels = boundaryPixels.size();
+
+    std::vector<uint32_t> labels;
+    std::vector<ComponentExtent> components(labelSpanComponents(holes.spans, labels));
+    for (size_t i = 0; i < holes.spans.size(); ++i) {
+        const HoleSpan& span = holes.spans[i];
+        ComponentExtent& extent = components[labels[i]];
+        extent.x0 = std::min(extent.x0, span.x0);
+        extent.x1 = std::max(extent.x1, span.x1);
+        extent.y0 = std::min(extent.y0, span.y);
+        extent.y1 = std::max(extent.y1, span.y + 1);
+        extent.area += static_cast<size_t>(span.x1 - span.x0);
+    }
+    plan.components = components.size();
+    const auto largest = std::max_element(components.begin(), components.end(),
+                                          [](const ComponentExtent& a, const ComponentExtent& b) { return a.area < b.area; });
+    if (largest != components.end()) {
+        plan.largestComponentWidth = largest->x1 - largest->x0;
+        plan.largestComponentHeight = largest->y1 - largest->y0;
+    }
+
+    const double scanSeconds = model.scanSecondsPerPixel * static_cast<double>(width) * height;
+    const double holeCount = static_cast<double>(holes.pixelCount);
+    const double boundary = static_cast<double>(boundaryPixels.size());
+
+    // Without holes nothing is filled, and without boundary every engine fills zeros
+    if (holes.empty() || boundaryPixels.empty()) {
+        plan.predictedSeconds = scanSeconds + model.approximateSecondsPerHole * holeCount;
+        plan.meetsTarget = target.latency <= 0.0 || plan.predictedSeconds <= target.latency;
+        plan.planSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return plan;
+    }
+
+    size_t profiles = 0;
+    const std::vector<Coord> samples = pickSamples(holes, labels, components, profiles);
+    std::vector<SampleErrors> sampleErrors(samples.size());
+    parallelFor(samples.size(), [&](const size_t s) {
+        sampleErrors[s] = measureSample(image, width, samples[s], boundaryPixels, weightFunc);
+    });
+
+    const auto [lowest, highest] = std::minmax_element(boundaryPixels.begin(), boundaryPixels.end(),
+                                                       [&](const Coord& a, const Coord& b) {
+        return image[static_cast<size_t>(a.y) * width + a.x] < image[static_cast<size_t>(b.y) * width + b.x];
+    });
+    const double boundaryRange = image[static_cast<size_t>(highest->y) * width + highest->x] -
+                                 image[static_cast<size_t>(lowest->y) * width + lowest->x];
+
+    // The engines fill zeros where the sum of weights falls below float epsilon. Where that happens at
+    // another depth for an engine than for fill(), the two differ by a whole value somewhere between
+    // two samples of a depth profile, however close they are at the samples themselves.
+    const auto vanishes = [](const double denominator) { return denominator <= std::numeric_limits<float>::epsilon(); };
+    const auto fallbackError = [&](const auto& denominatorOf) {
+        double error = 0.0;
+        for (size_t p = 0; p < profiles; ++p) {
+            for (size_t d = 0; d + 1 < planDepthSamples; ++d) {
+                const SampleErrors& deep = sampleErrors[p * planDepthSamples + d];
+                const SampleErrors& shallow = sampleErrors[p * planDepthSamples + d + 1];
+                const bool switches = vanishes(denominatorOf(deep)) != vanishes(denominatorOf(shallow)) ||
+                                      vanishes(deep.denominator) != vanishes(shallow.denominator);
+                // Sums within a percent of each other vanish within a fraction of a pixel of each other. Near
+                // the boundary the nearest pixels carry all weight, so the deeper sample tells more.
+                if (switches && denominatorOf(deep) < 0.99 * deep.denominator) {
+                    error = std::max({error, std::abs(deep.value), std::abs(shallow.value)});
+                }
+            }
+        }
+        return error;
+    };
+
+    std::vector<PlanCandidate> candidates;
+    candidates.push_back({FillMethod::Approximate, 0, 0, scanSeconds + model.approximateSecondsPerHole * holeCount,
+                          boundaryRange});
+
+    for (size_t c = 0; c < planNeighborCounts.size(); ++c) {
+        double error = fallbackError([&](const SampleErrors& errors) { return errors.nearestDenominators[c]; });
+        for (const SampleErrors& errors : sampleErrors) error = std::max(error, nearestErrorMargin * errors.nearest[c]);
+        const double neighbors = holeCount * static_cast<double>(planNeighborCounts[c]) * std::log2(boundary + 2.0);
+        candidates.push_back({FillMethod::Search, planNeighborCounts[c], 0,
+                              scanSeconds + model.searchSecondsPerNeighbor * neighbors, error});
+        candidates.push_back({FillMethod::DualTree, planNeighborCounts[c], 0,
+                              scanSeconds + model.dualTreeSecondsPerNeighbor * neighbors, error});
+        // Larger k sum the same whole boundary
+        if (planNeighborCounts[c] >= boundaryPixels.size()) break;
+    }
+
+    // The estimated sum of weights may vanish where the actual one is within its standard errors of vanishing
+    for (const size_t samplesPerPixel : planSamplesPerPixel) {
+        const double deviations = stochasticErrorDeviations / std::sqrt(static_cast<double>(samplesPerPixel));
+        const auto lowestEstimate = [&](const SampleErrors& errors) { return errors.denominator * (1.0 - deviations); };
+        double error = fallbackError(lowestEstimate);
+        for (const SampleErrors& errors : sampleErrors) {
+            error = std::max(error, deviations * errors.spread);
+            if (vanishes(lowestEstimate(errors))) error = std::max(error, std::abs(errors.value));
+        }
+        candidates.push_back({FillMethod::Stochastic, 0, samplesPerPixel,
+                              scanSeconds + model.stochasticSecondsPerSample * holeCount * static_cast<double>(samplesPerPixel),
+                              error});
+    }
+
+    candidates.push_back({FillMethod::Exact, 0, 0, scanSeconds + model.exactSecondsPerPair * holeCount * boundary, 0.0});
+
+    const auto withinTolerance = [&](const PlanCandidate& c) { return c.error <= target.tolerance; };
+    const auto withinLatency = [&](const PlanCandidate& c) { return target.latency <= 0.0 || c.seconds <= target.latency; };
+    const auto faster = [](const PlanCandidate& a, const PlanCandidate& b) { return a.seconds < b.seconds; };
+
+    const PlanCandidate* chosen = nullptr;
+    for (const PlanCandidate& c : candidates) {
+        if (withinTolerance(c) && withinLatency(c) && (!chosen || faster(c, *chosen))) chosen = &c;
+    }
+    plan.meetsTarget = chosen != nullptr;
+    if (!chosen) {
+        for (const PlanCandidate& c : candidates) {
+            if (withinLatency(c) && (!chosen || c.error < chosen->error)) chosen = &c;
+        }
+    }
+    if (!chosen) chosen = &*std::min_element(candidates.begin(), candidates.end(), faster);
+
+    plan.method = chosen->method;
+    plan.nearestNeighborMax = chosen->nearestNeighborMax;
+    plan.samplesPerPixel = chosen->samplesPerPixel;
+    plan.predictedSeconds = chosen->seconds;
+    plan.predictedError = static_cast<float>(chosen->error);
+    plan.planSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return plan;
+}
+
+FillPlan fillAuto(float* const image, const int32_t width, const int32_t height, const WeightFunction weightFunc,
+                  const FillTarget& target, const FillOptions& options) {
+    FillPlan plan = planFill(image, width, height, weightFunc, target);
+
+    FillJob job;
+    job.image = image;
+    job.width = width;
+    job.height = height;
+    job.method = plan.method;
+    job.weightFunc = weightFunc;
+    job.nearestNeighborMax = plan.nearestNeighborMax;
+    job.samplesPerPixel = plan.samplesPerPixel;
+    job.options = options;
+
+    const auto start = std::chrono::steady_clock::now();
+    runFillJob(job);
+    plan.actualSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return plan;
+}
+
+} // namespace holefill
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "holefill.h"
+#include "holefill_batch.h"
+
+namespace holefill {
+
+/**
+ * @brief Accuracy and time a planned fill has to meet.
+ */
+struct FillTarget {
+    /// Largest acceptable difference from the fill() result at any hole pixel, in image units
+    float tolerance = 1.0e-2f;
+    /// Seconds the fill may take, 0 for no limit
+    double latency = 0.0;
+};
+
+/**
+ * @brief Engine and parameters chosen by planFill(), with the measurements and predictions behind the choice.
+ */
+struct FillPlan {
+    FillMethod method = FillMethod::Approximate;
+    /// Search and DualTree
+    size_t nearestNeighborMax = 0;
+    /// Stochastic
+    size_t samplesPerPixel = 0;
+
+    size_t holePixels = 0;
+    size_t boundaryPixels = 0;
+    /// 8-connected components of the holes
+    size_t components = 0;
+    /// Bounding box of the component with the most hole pixels
+    int32_t largestComponentWidth = 0;
+    int32_t largestComponentHeight = 0;
+
+    /// Fill time predicted by the cost model of tuning()
+    double predictedSeconds = 0.0;
+    /// Largest difference from the fill() result predicted at the sampled hole pixels
+    float predictedError = 0.0f;
+    /// Whether the plan is predicted to meet both the tolerance and the latency of the target
+    bool meetsTarget = true;
+    /// Time of the pre-pass that made the plan
+    double planSeconds = 0.0;
+    /// Time of the fill, set by fillAuto()
+    double actualSeconds = 0.0;
+};
+
+/**
+ * @brief Picks the fastest engine and parameters predicted to meet a target, without modifying the image.
+ *
+ * A pre-pass works as follows:
+ * 1. Finds the hole spans, the boundary pixels and the 8-connected components of the holes
+ * 2. Samples 48 hole pixels: four from the centre to the edge of each of the eight largest components,
+ *    since truncation errors grow with the distance from the boundary, and the rest spread evenly
+ * 3. At each sample, sums the whole boundary as fill() does and compares the result with the
+ *    weighted average of the k nearest boundary pixels for k from 4 to 256, giving the error of
+ *    fillExactWithSearch and fillExactWithDualTreeSearch. The weighted spread of the boundary values
+ *    gives the error of fillStochastic at each sample count, and the range of all boundary values
+ *    bounds the error of fillApproximate. Where the weights vanish deep inside a hole, the engines
+ *    fill zeros; the depth samples also show where that happens for a candidate but not for fill().
+ * 4. Predicts the time of every candidate from the cost model in tuning()
+ *
+ * The fastest candidate within both the tolerance and the latency is chosen. When none is, the most
+ * accurate candidate within the latency is chosen, or the fastest one if none is within it, and
+ * FillPlan::meetsTarget is false. fill() always meets the tolerance. fillAdaptive is not a candidate,
+ * as its cost depends on the smoothness of the result, which the pre-pass does not see.
+ *
+ * @param image Pointer to the image data as a flat array of floats, linear values. Negative values indicate holes.
+ * @param weightFunc Weight function the fill will use, called at the samples.
+ *
+ * @note The pre-pass costs about as much as 48 hole pixels of fill() besides the scans for holes and boundary.
+ */
+FillPlan planFill(const float* image, int32_t width, int32_t height, const WeightFunction& weightFunc,
+                  const FillTarget& target = {});
+
+/**
+ * @brief Plans a fill with planFill() and runs it, recording the time it took in FillPlan::actualSeconds.
+ *
+ * @param options Options of the fill; the pre-pass does not count against the memory budget.
+ */
+FillPlan fillAuto(float* image, int32_t width, int32_t height, WeightFunction weightFunc,
+                  const FillTarget& target = {}, const FillOptions& options = {});
+
+} // namespace holefill
@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "holefill_session.h"
+#include "parallel.h"
+
+namespace holefill {
+
+FillSession::FillSession(const float* const image, const int32_t width, const int32_t height)
+    : width_(width), height_(height), image_(image, image + static_cast<size_t>(width) * height) {}
+
+void FillSession::fill(const std::span<SessionMask> masks, const FillJob& parameters) const {
+    // Masks of another size fail on their own, before any copy
+    std::vector<size_t> valid;
+    valid.reserve(masks.size());
+    for (size_t i = 0; i < masks.size(); ++i) {
+        SessionMask& entry = masks[i];
+        entry.error = nullptr;
+        if (!entry.mask || !entry.output || entry.mask->width() != width_ || entry.mask->height() != height_) {
+            entry.error = std::make_exception_ptr(std::invalid_argument("Mask does not match the session image"));
+        } else {
+            valid.push_back(i);
+        }
+    }
+
+    // One row per task, so a single large mask still spreads over the pool
+    const size_t rows = static_cast<size_t>(height_);
+    parallelFor(valid.size() * rows, [&](const size_t task) {
+        const SessionMask& entry = masks[valid[task / rows]];
+        const size_t offset = (task % rows) * static_cast<size_t>(width_);
+        std::copy(image_.data() + offset, image_.data() + offset + width_, entry.output + offset);
+    });
+    for (const size_t i : valid) masks[i].mask->applyTo(masks[i].output);
+
+    std::vector<FillJob> jobs(valid.size(), parameters);
+    for (size_t v = 0; v < valid.size(); ++v) {
+        FillJob& job = jobs[v];
+        job.image = masks[valid[v]].output;
+        job.width = width_;
+        job.height = height_;
+        job.variance = nullptr;
+        job.options.stats = masks[valid[v]].stats;
+        job.error = nullptr;
+    }
+    fillBatch(jobs);
+
+    for (size_t v = 0; v < valid.size(); ++v) masks[valid[v]].error = jobs[v].error;
+}
+
+} // namespace holefill
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <span>
+#include <vector>
+
+#include "holefill.h"
+#include "holefill_batch.h"
+#include "holefill_mask.h"
+
+namespace holefill {
+
+/**
+ * @brief One mask of a FillSession::fill call and the buffer its result goes to.
+ */
+struct SessionMask {
+    /// Holes to fill, of the size of the session image
+    const HoleMask* mask = nullptr;
+    /// Receives the session image with the holes of mask filled: width * height floats
+    float* output = nullptr;
+    /// Optional output, as FillOptions::stats of a single fill
+    FillStats* stats = nullptr;
+    /// Output: the exception the fill threw, e.g. MemoryBudgetExceeded, or null on success
+    std::exception_ptr error;
+};
+
+/**
+ * @brief An image kept resident to be filled with many alternative masks, e.g. object removal candidates.
+ *
+ * Filling one image with dozens of masks through the single-image functions decodes, converts and
+ * copies the image once per mask. A session takes the linear float image once; each mask then only
+ * costs a copy of the image into its output, marking its holes and the fill itself.
+ *
+ * @code
+ * holefill::FillSession session(linearImage.data(), width, height);
+ * std::vector<holefill::SessionMask> masks(candidates.size());
+ * for (size_t i = 0; i < candidates.size(); ++i) masks[i] = {&candidates[i], outputs[i].data()};
+ * holefill::FillJob parameters;
+ * parameters.weightFunc = weightFunc;
+ * session.fill(masks, parameters);
+ * @endcode
+ */
+class FillSession {
+public:
+    /**
+     * @brief Copies a linear float image. Negative values in it are holes of every mask.
+     */
+    FillSession(const float* image, int32_t width, int32_t height);
+
+    int32_t width() const { return width_; }
+    int32_t height() const { return height_; }
+    const float* image() const { return image_.data(); }
+
+    /**
+     * @brief Fills the image with the holes of each mask into the output of the mask, in parallel across masks.
+     *
+     * The copies run in parallel, and the fills run as one fillBatch() call, so small masks are filled
+     * side by side and large ones are split over the thread pool. Results are the same as filling a
+     * copy of the image with each mask on its own.
+     *
+     * @param masks The masks to fill. Failures, including masks of another size than the image, are
+     *              stored in SessionMask::error; the other masks are still filled.
+     * @param parameters Engine and parameters of every fill. Its image, size, variance and stats are
+     *                   ignored; the stats of each fill go to SessionMask::stats.
+     */
+    void fill(std::span<SessionMask> masks, const FillJob& parameters) const;
+
+private:
+    int32_t width_;
+    int32_t height_;
+    std::vector<float> image_;
+};
+
+} // namespace holefill
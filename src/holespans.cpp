@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <numeric>
+
+#include "holespans.h"
+#include "occupancy.h"
+#include "kernels.h"
+
+namespace holefill {
+
+HoleSpans::HoleSpans(const float* const image, const TileOccupancy& occupancy,
+                     std::pmr::memory_resource* const resource)
+    : spans(resource) {
+    const Kernels& k = kernels();
+
+    // Calls emit(y, x0, x1) for every run of hole pixels. Tiles without holes separate the runs of
+    // occupied tiles, so no span crosses from one run of tiles into the next.
+    const auto forEachRun = [&](const auto& emit) {
+        for (int32_t ty = 0; ty < occupancy.tilesY; ++ty) {
+            const int32_t y1 = std::min(occupancy.height, (ty + 1) * TileOccupancy::tileSize);
+            for (int32_t y = ty * TileOccupancy::tileSize; y < y1; ++y) {
+                const float* const row = image + static_cast<size_t>(y) * occupancy.width;
+                occupancy.forEachRun(ty, [&](const int32_t begin, const int32_t end) {
+                    int32_t x = begin + static_cast<int32_t>(k.findNegative(row + begin, end - begin));
+                    while (x < end) {
+                        const int32_t x1 = x + static_cast<int32_t>(k.findNonNegative(row + x, end - x));
+                        emit(y, x, x1);
+                        x = x1 + static_cast<int32_t>(k.findNegative(row + x1, end - x1));
+                    }
+                });
+            }
+        }
+    };
+
+    size_t count = 0;
+    forEachRun([&](int32_t, int32_t, int32_t) { ++count; });
+
+    spans.reserve(count);
+    forEachRun([&](const int32_t y, const int32_t x0, const int32_t x1) {
+        spans.push_back({y, x0, x1});
+        pixelCount += static_cast<size_t>(x1 - x0);
+    });
+}
+
+HoleSpans::HoleSpans(const float* const image, const int32_t width, const int32_t height,
+                     std::pmr::memory_resource* const resource)
+    : HoleSpans(image, TileOccupancy(image, width, height, resource), resource) {}
+
+size_t labelSpanComponents(const std::span<const HoleSpan> spans, std::vector<uint32_t>& labels) {
+    std::vector<uint32_t> parent(spans.size());
+    std::iota(parent.begin(), parent.end(), 0u);
+    const auto find = [&](uint32_t i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    const auto unite = [&](const uint32_t a, const uint32_t b) {
+        const uint32_t ra = find(a);
+        const uint32_t rb = find(b);
+        if (ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+    };
+
+    // Spans of the previous row are [above, row), those of the current row [row, end)
+    size_t above = 0;
+    size_t row = 0;
+    while (row < spans.size()) {
+        const int32_t y = spans[row].y;
+        size_t end = row + 1;
+        while (end < spans.size() && spans[end].y == y) {
+            if (spans[end - 1].x1 == spans[end].x0) unite(static_cast<uint32_t>(end - 1), static_cast<uint32_t>(end));
+            ++end;
+        }
+
+        // Spans of adjacent rows touch, diagonals included, when each starts at most one past the other's end
+        if (row > 0 && spans[above].y == y - 1) {
+            size_t a = above;
+            size_t b = row;
+            while (a < row && b < end) {
+                if (spans[a].x0 <= spans[b].x1 && spans[b].x0 <= spans[a].x1) {
+                    unite(static_cast<uint32_t>(a), static_cast<uint32_t>(b));
+                }
+                if (spans[a].x1 < spans[b].x1) {
+                    ++a;
+                } else {
+                    ++b;
+                }
+            }
+        }
+        above = row;
+        row = end;
+    }
+
+    // Roots are the first span of their component, so numbering them in order numbers the components
+    labels.resize(spans.size());
+    uint32_t count = 0;
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const uint32_t root = find(static_cast<uint32_t>(i));
+        labels[i] = (root == i) ? count++ : labels[root];
+    }
+    return count;
+}
+
+} // namespace holefill
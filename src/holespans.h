@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include "holefill.h"
+
+namespace holefill {
+
+struct TileOccupancy;
+
+// Maximal run [x0, x1) of hole pixels on row y
+struct HoleSpan {
+    int32_t y;
+    int32_t x0;
+    int32_t x1;
+};
+
+// Run-length encoded hole mask: every maximal run of negative values, sorted by row and then by x.
+// Memory grows with the number of runs, i.e. with the perimeter of the holes, not with their area.
+// The spans are a snapshot of the image at construction, so engines may fill pixels while iterating them.
+struct HoleSpans {
+    std::pmr::vector<HoleSpan> spans;
+    size_t pixelCount = 0;
+
+    // Scans the occupied tiles of the image with the findNegative and findNonNegative kernels, once
+    // to count the runs and once to record them, so the spans are allocated exactly once
+    HoleSpans(const float* image, const TileOccupancy& occupancy,
+              std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Builds a temporary TileOccupancy of the image first
+    HoleSpans(const float* image, int32_t width, int32_t height,
+              std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    bool empty() const { return spans.empty(); }
+
+    // Calls visit(x, y) for every hole pixel in row-major order
+    template <typename Visit>
+    void forEachPixel(const Visit& visit) const {
+        for (const HoleSpan& span : spans) {
+            for (int32_t x = span.x0; x < span.x1; ++x) visit(x, span.y);
+        }
+    }
+};
+
+// Labels the 8-connected components of spans sorted by row and then by x, as in HoleSpans: labels[i]
+// becomes the component of spans[i], numbered from 0 in order of their first span. Returns the
+// number of components. Spans of adjacent rows are merged with a union-find, so the work grows with
+// the number of spans rather than with the number of pixels.
+size_t labelSpanComponents(std::span<const HoleSpan> spans, std::vector<uint32_t>& labels);
+
+// Collects the valid neighbors of all hole pixels, each once, in the order of the hole pixels.
+// Defined with the engines that use it.
+std::pmr::vector<Coord> findBoundaryPixels(const float* image, int32_t width, int32_t height,
+                                           const HoleSpans& holes, std::pmr::memory_resource* resource,
+                                           bool use8Connectivity = true);
+
+} // namespace holefill
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include "holefill.h"
+#include "kernels.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace holefill {
+
+const Kernels* kernelsFor(const Isa isa) {
+    switch (isa) {
+        case Isa::SSE42: return sse42Kernels;
+        case Isa::AVX2: return avx2Kernels;
+        case Isa::AVX512: return avx512Kernels;
+        default: return &scalarKernels;
+    }
+}
+
+bool cpuSupports(const Isa isa) {
+    if (isa == Isa::Scalar) return true;
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+    __builtin_cpu_init();
+    switch (isa) {
+        case Isa::SSE42: return __builtin_cpu_supports("sse4.2");
+        case Isa::AVX2: return __builtin_cpu_supports("avx2");
+        case Isa::AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                                 __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq");
+        default: return false;
+    }
+#elif defined(_MSC_VER) && defined(_M_X64)
+    int info[4];
+    __cpuid(info, 1);
+    const bool sse42 = (info[2] >> 20) & 1;
+    const bool osxsave = (info[2] >> 27) & 1;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(info, 7, 0);
+    switch (isa) {
+        case Isa::SSE42: return sse42;
+        case Isa::AVX2: return ((xcr0 & 0x6) == 0x6) && ((info[1] >> 5) & 1);
+        case Isa::AVX512: return ((xcr0 & 0xE6) == 0xE6) && ((info[1] >> 16) & 1) && ((info[1] >> 17) & 1) &&
+                                 ((info[1] >> 30) & 1) && ((info[1] >> 31) & 1);
+        default: return false;
+    }
+#else
+    return false;
+#endif
+}
+
+constexpr Isa allIsas[] = {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512};
+
+// Widest supported instruction set, unless HOLEFILL_ISA names another supported one
+Isa defaultIsa() {
+    Isa isa = Isa::Scalar;
+    for (const Isa candidate : allIsas) {
+        if (isaSupported(candidate)) isa = candidate;
+    }
+
+    Isa requested;
+    const char* const name = std::getenv("HOLEFILL_ISA");
+    if (name && parseIsa(name, requested) && isaSupported(requested)) isa = requested;
+    return isa;
+}
+
+std::atomic<int> activeIsaIndex{-1};
+
+const char* isaName(const Isa isa) {
+    switch (isa) {
+        case Isa::SSE42: return "sse4.2";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+bool parseIsa(const char* const name, Isa& isa) {
+    for (const Isa candidate : allIsas) {
+        if (std::strcmp(name, isaName(candidate)) == 0) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isaSupported(const Isa isa) {
+    return kernelsFor(isa) != nullptr && cpuSupports(isa);
+}
+
+Isa activeIsa() {
+    int index = activeIsaIndex.load(std::memory_order_relaxed);
+    if (index < 0) {
+        // Threads racing here all compute the same default
+        int expected = -1;
+        activeIsaIndex.compare_exchange_strong(expected, static_cast<int>(defaultIsa()));
+        index = activeIsaIndex.load(std::memory_order_relaxed);
+    }
+    return static_cast<Isa>(index);
+}
+
+bool selectIsa(const Isa isa) {
+    if (!isaSupported(isa)) return false;
+    activeIsaIndex.store(static_cast<int>(isa), std::memory_order_relaxed);
+    return true;
+}
+
+const Kernels& kernels() {
+    return *kernelsFor(activeIsa());
+}
+
+} // namespace holefill
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace holefill {
+
+// Hot loops of the fill engines. Each instruction set gets its own build of these functions
+// (kernels_<isa>.cpp) and kernels() returns the table chosen for the running CPU.
+struct Kernels {
+    // Index of the first negative value of values[0, count), or count if there is none
+    size_t (*findNegative)(const float* values, size_t count);
+
+    // Index of the first value of values[0, count) that is not negative, or count if there is none
+    size_t (*findNonNegative)(const float* values, size_t count);
+
+    // Number of negative values in values[0, count)
+    size_t (*countNegative)(const float* values, size_t count);
+
+    // Sets bit i of bits when values[i] < threshold, writing (count + 63) / 64 words. Bits past count are zero.
+    void (*thresholdBits)(const uint8_t* values, size_t count, uint8_t threshold, uint64_t* bits);
+
+    // Squared distances from (x, y) to the n points (xs[i], ys[i]), and the smallest distance of every
+    // group of kernelGroupSize points. n must not exceed kernelBlockSize.
+    void (*squaredDistances)(const int32_t* xs, const int32_t* ys, uint32_t n, int32_t x, int32_t y,
+                             uint32_t* distances, uint32_t* groupMinima);
+};
+
+constexpr uint32_t kernelGroupSize = 16;
+constexpr uint32_t kernelBlockSize = 256;
+
+// Table chosen for the running CPU, see selectIsa()
+const Kernels& kernels();
+
+// Tables of the individual builds, null where the build is not available on this platform
+extern const Kernels scalarKernels;
+extern const Kernels* const sse42Kernels;
+extern const Kernels* const avx2Kernels;
+extern const Kernels* const avx512Kernels;
+
+} // namespace holefill
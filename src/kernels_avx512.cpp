@@ -0,0 +1,23 @@
+// AVX-512 build of the kernels, compiled with the flags set in CMakeLists.txt
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#define HOLEFILL_KERNEL_NAMESPACE avx512
+#include "kernels_impl.h"
+
+namespace holefill {
+
+const Kernels* const avx512Kernels = &avx512::table;
+
+} // namespace holefill
+
+#else
+
+namespace holefill {
+
+const Kernels* const avx512Kernels = nullptr;
+
+} // namespace holefill
+
+#endif
@@ -0,0 +1,88 @@
+// Kernel bodies, included once per instruction set by kernels_<isa>.cpp with HOLEFILL_KERNEL_NAMESPACE
+// defined. The loops are written without early exits or calls into headers
+// shared with other translation units, so the compiler vectorizes them for the flags of the including
+// file and no inline function built for a wider instruction set can leak into the rest of the program.
+
+#include "kernels.h"
+
+namespace holefill::HOLEFILL_KERNEL_NAMESPACE {
+
+size_t findNegative(const float* const values, const size_t count) {
+    constexpr size_t block = 64;
+
+    // Inside a hole the next pixel is usually a hole as well
+    if (count > 0 && values[0] < 0.0f) return 0;
+
+    size_t begin = 0;
+    for (; begin + block <= count; begin += block) {
+        int any = 0;
+        for (size_t i = 0; i < block; ++i) any |= values[begin + i] < 0.0f;
+        if (any) break;
+    }
+    for (size_t i = begin; i < count; ++i) {
+        if (values[i] < 0.0f) return i;
+    }
+    return count;
+}
+
+size_t findNonNegative(const float* const values, const size_t count) {
+    constexpr size_t block = 64;
+
+    // Inside a hole the next pixel is usually a hole as well, so the first block is checked pixel by pixel
+    const size_t head = count < block ? count : block;
+    for (size_t i = 0; i < head; ++i) {
+        if (!(values[i] < 0.0f)) return i;
+    }
+
+    size_t begin = head;
+    for (; begin + block <= count; begin += block) {
+        int all = 1;
+        for (size_t i = 0; i < block; ++i) all &= values[begin + i] < 0.0f;
+        if (!all) break;
+    }
+    for (size_t i = begin; i < count; ++i) {
+        if (!(values[i] < 0.0f)) return i;
+    }
+    return count;
+}
+
+size_t countNegative(const float* const values, const size_t count) {
+    size_t negative = 0;
+    for (size_t i = 0; i < count; ++i) negative += values[i] < 0.0f ? 1 : 0;
+    return negative;
+}
+
+void thresholdBits(const uint8_t* const values, const size_t count, const uint8_t threshold, uint64_t* const bits) {
+    const size_t words = count / 64;
+    for (size_t w = 0; w < words; ++w) {
+        uint64_t word = 0;
+        for (size_t i = 0; i < 64; ++i) word |= static_cast<uint64_t>(values[w * 64 + i] < threshold) << i;
+        bits[w] = word;
+    }
+    if (count % 64) {
+        uint64_t word = 0;
+        for (size_t i = words * 64; i < count; ++i) word |= static_cast<uint64_t>(values[i] < threshold) << (i % 64);
+        bits[words] = word;
+    }
+}
+
+void squaredDistances(const int32_t* const xs, const int32_t* const ys, const uint32_t n, const int32_t x,
+                      const int32_t y, uint32_t* const distances, uint32_t* const groupMinima) {
+    for (uint32_t i = 0; i < n; ++i) {
+        const int32_t dx = xs[i] - x;
+        const int32_t dy = ys[i] - y;
+        distances[i] = static_cast<uint32_t>(dx * dx) + static_cast<uint32_t>(dy * dy);
+    }
+
+    for (uint32_t group = 0; group * kernelGroupSize < n; ++group) {
+        const uint32_t begin = group * kernelGroupSize;
+        const uint32_t end = (begin + kernelGroupSize < n) ? begin + kernelGroupSize : n;
+        uint32_t nearest = 0xFFFFFFFFu;
+        for (uint32_t i = begin; i < end; ++i) nearest = distances[i] < nearest ? distances[i] : nearest;
+        groupMinima[group] = nearest;
+    }
+}
+
+const Kernels table = {findNegative, findNonNegative, countNegative, thresholdBits, squaredDistances};
+
+} // namespace holefill::HOLEFILL_KERNEL_NAMESPACE
@@ -0,0 +1,9 @@
+// Scalar build of the kernels, compiled without auto-vectorization (see CMakeLists.txt)
+#define HOLEFILL_KERNEL_NAMESPACE scalar
+#include "kernels_impl.h"
+
+namespace holefill {
+
+const Kernels scalarKernels = scalar::table;
+
+} // namespace holefill
@@ -0,0 +1,23 @@
+// SSE4.2 build of the kernels, compiled with the flags set in CMakeLists.txt
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#define HOLEFILL_KERNEL_NAMESPACE sse42
+#include "kernels_impl.h"
+
+namespace holefill {
+
+const Kernels* const sse42Kernels = &sse42::table;
+
+} // namespace holefill
+
+#else
+
+namespace holefill {
+
+const Kernels* const sse42Kernels = nullptr;
+
+} // namespace holefill
+
+#endif
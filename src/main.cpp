@@ -1,35 +1,35 @@
 #include "holefill.h"
+#include "holefill_batch.h"
+#include "holefill_mask.h"
+#include "holefill_plan.h"
+#include "holefill_session.h"
+#include "arena.h"
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <cmath>
 #include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <chrono>
+#include <thread>
+
+#include "color.h"
+#include "coordinator.h"
+#include "stream.h"
 
 #include "stb_image.h"
 #include "stb_image_write.h"
 
-float srgbToLinear(const float c) {
-    if (c <= 0.04045f)
-        return c / 12.92f;
-    else
-        return powf((c + 0.055f) / 1.055f, 2.4f);
-}
-
-float linearToSrgb(const float c) {
-    if (c <= 0.0031308f)
-        return c * 12.92f;
-    else
-        return 1.055f * powf(c, 1.0f/2.4f) - 0.055f;
-}
-
-// Convert sRGB to grayscale float in [0,1]
-float rgbToGrayscaleLinear(const unsigned char r, const unsigned char g, const unsigned char b) {
-    const float rf = srgbToLinear(r / 255.0f);
-    const float gf = srgbToLinear(g / 255.0f);
-    const float bf = srgbToLinear(b / 255.0f);
-    return 0.299f * rf + 0.587f * gf + 0.114f * bf;
-}
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 static float defaultWeightFunction(const holefill::Coord& u, const holefill::Coord& v) {
     const float epsilon = 0.01f;
@@ -40,21 +40,81 @@ static float defaultWeightFunction(const holefill::Coord& u, const holefill::Coo
     return 1.0f / powf(distanceSquared + epsilon, zeta);
 }
 
-int main(const int argc, const char** const argv) {
-    if (argc < 5) {
-        std::cerr << "Usage: " << argv[0] << " <image.png> <mask.png> <output.png> <fill_method>\n"
-                  << "Fill methods:\n"
-                  << "  exact     - Exact fill using default weight function\n"
-                  << "  approx    - Approximate fill using windowed weight function\n"
-                  << "  search    - Exact fill with search using default weight function\n";
-        return 1;
+// Cheap cost estimate from the mask alone: hole pixels times the boundary work each of them does
+double estimateJobCost(const FillJobSpec& job) {
+    int width, height;
+    unsigned char* const maskData = stbi_load(job.maskPath.c_str(), &width, &height, nullptr, 1);
+    if (!maskData) return 0.0;
+
+    // Same threshold as fillImage: linear grayscale below 0.5
+    const auto isHole = [&](const int x, const int y) {
+        return srgbToLinearTable()[maskData[y * width + x]] < 0.5f;
+    };
+
+    double holes = 0.0;
+    double boundary = 0.0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (!isHole(x, y)) continue;
+            holes += 1.0;
+            const bool edge = (x > 0 && !isHole(x - 1, y)) || (x + 1 < width && !isHole(x + 1, y)) ||
+                              (y > 0 && !isHole(x, y - 1)) || (y + 1 < height && !isHole(x, y + 1));
+            boundary += edge ? 1.0 : 0.0;
+        }
     }
+    stbi_image_free(maskData);
 
-    const char* const imagePath = argv[1];
-    const char* const maskPath = argv[2];
-    const char* const outputPath = argv[3];
-    const std::string fillMethod = argv[4];
+    if (job.method == "approx") return holes;
+    if (job.method == "search" || job.method == "dualtree") return holes * 100.0 * std::log2(boundary + 2.0);
+    if (job.method == "stochastic") return holes * 64.0;
+    return holes * boundary;
+}
+
+// Clean-up step of the mask, from --dilate, --erode and --min-area, applied in command-line order
+struct MaskStep {
+    enum class Kind { Dilate, Erode, MinArea } kind;
+    size_t amount;
+};
+
+void applyMaskStep(const MaskStep& step, holefill::HoleMask& mask) {
+    switch (step.kind) {
+        case MaskStep::Kind::Dilate: mask.dilate(static_cast<int32_t>(std::min<size_t>(step.amount, INT32_MAX))); break;
+        case MaskStep::Kind::Erode: mask.erode(static_cast<int32_t>(std::min<size_t>(step.amount, INT32_MAX))); break;
+        case MaskStep::Kind::MinArea: mask.removeComponentsSmallerThan(step.amount); break;
+    }
+}
+
+// Smallest 8-bit mask value whose grayscale is at least 0.5, i.e. that is not a hole
+uint8_t maskHoleLevel() {
+    int level = 0;
+    while (level < 255 && rgbToGrayscaleLinear(level, level, level) < 0.5f) ++level;
+    return static_cast<uint8_t>(level);
+}
 
+// Linear grayscale of an 8-bit sRGB image with three channels
+std::vector<float> toGrayscaleLinear(const unsigned char* const rgb, const int width, const int height) {
+    std::vector<float> grayscaleImage(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < grayscaleImage.size(); ++i) {
+        const size_t idx = i * 3;
+        grayscaleImage[i] = rgbToGrayscaleLinear(rgb[idx], rgb[idx + 1], rgb[idx + 2]);
+    }
+    return grayscaleImage;
+}
+
+// Converts a float image [0,1] to 8-bit grayscale and writes it as a PNG
+bool writeGrayscalePng(const char* const path, const float* const image, const int width, const int height) {
+    std::vector<unsigned char> outputImage(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < outputImage.size(); ++i) {
+        outputImage[i] = linearToSrgb8(image[i]);
+    }
+    return stbi_write_png(path, width, height, 1, outputImage.data(), width) != 0;
+}
+
+// Loads, fills and writes one image. Returns 0 on success.
+int fillImage(const char* const imagePath, const char* const maskPath, const char* const outputPath,
+              const std::string& fillMethod, const holefill::FillOptions& options = {},
+              const std::vector<MaskStep>& maskSteps = {}, const holefill::FillTarget& target = {},
+              holefill::FillPlan* const plan = nullptr, holefill::HybridFillReport* const report = nullptr) {
     int width, height, channels;
     const unsigned char* const imageData = stbi_load(imagePath, &width, &height, &channels, 3);  // Force 3 channels
     const unsigned char* const maskData = stbi_load(maskPath, &width, &height, nullptr, 1);      // Force 1 channel
@@ -66,53 +126,397 @@ int main(const int argc, const char** const argv) {
         return 1;
     }
 
+    // Holes where the mask grayscale is below 0.5, packed one bit per pixel for the clean-up steps
+    holefill::HoleMask mask = holefill::HoleMask::threshold(maskData, width, height, maskHoleLevel());
+    for (const MaskStep& step : maskSteps) applyMaskStep(step, mask);
+
     // Grayscale float image with hole
-    std::vector<float> grayscaleImage(width * height);
+    std::vector<float> grayscaleImage = toGrayscaleLinear(imageData, width, height);
+    mask.applyTo(grayscaleImage.data());
 
-    for (int i = 0; i < width * height; ++i) {
-        const int idx = i * 3;
+    // Fill the hole using the selected method
+    try {
+        if (fillMethod == "exact") {
+            holefill::fill(grayscaleImage.data(), width, height, defaultWeightFunction, options);
+        } else if (fillMethod == "approx") {
+            holefill::fillApproximate(grayscaleImage.data(), width, height, options);
+        } else if (fillMethod == "search") {
+            holefill::fillExactWithSearch(grayscaleImage.data(), width, height, defaultWeightFunction, 100, options);
+        } else if (fillMethod == "adaptive") {
+            holefill::fillAdaptive(grayscaleImage.data(), width, height, defaultWeightFunction, 1.0e-3f, 32, options);
+        } else if (fillMethod == "stochastic") {
+            holefill::fillStochastic(grayscaleImage.data(), width, height, defaultWeightFunction, 64, nullptr, 0, options);
+        } else if (fillMethod == "dualtree") {
+            holefill::fillExactWithDualTreeSearch(grayscaleImage.data(), width, height, defaultWeightFunction, 100, options);
+        } else if (fillMethod == "multires") {
+            holefill::fillMultiresolution(grayscaleImage.data(), width, height, defaultWeightFunction, 2, 0.1f, options);
+        } else if (fillMethod == "hybrid") {
+            const holefill::HybridFillReport refined = holefill::fillHybrid(grayscaleImage.data(), width, height,
+                                                                            defaultWeightFunction, target.tolerance,
+                                                                            16, options);
+            if (report) *report = refined;
+        } else if (fillMethod == "auto") {
+            const holefill::FillPlan chosen = holefill::fillAuto(grayscaleImage.data(), width, height, defaultWeightFunction,
+                                                                 target, options);
+            if (plan) *plan = chosen;
+        } else {
+            std::cerr << "Invalid fill method: " << fillMethod << "\n";
+            stbi_image_free(const_cast<unsigned char*>(imageData));
+            stbi_image_free(const_cast<unsigned char*>(maskData));
+            return 1;
+        }
+    } catch (const holefill::MemoryBudgetExceeded& e) {
+        std::cerr << e.what() << "\n";
+        stbi_image_free(const_cast<unsigned char*>(imageData));
+        stbi_image_free(const_cast<unsigned char*>(maskData));
+        return 1;
+    }
+
+    // Save output
+    if (!writeGrayscalePng(outputPath, grayscaleImage.data(), width, height)) {
+        std::cerr << "Failed to write output image.\n";
+        return 1;
+    }
+
+    stbi_image_free(const_cast<unsigned char*>(imageData));
+    stbi_image_free(const_cast<unsigned char*>(maskData));
+    return 0;
+}
 
-        // Convert base image to grayscale
-        const float grayscale = rgbToGrayscaleLinear(imageData[idx], imageData[idx + 1], imageData[idx + 2]);
+// Engine the planner chose and how its predictions compare with the fill
+void printPlan(const holefill::FillPlan& plan) {
+    std::cout << "Plan: " << holefill::fillMethodName(plan.method);
+    if (plan.nearestNeighborMax) std::cout << " k=" << plan.nearestNeighborMax;
+    if (plan.samplesPerPixel) std::cout << " samples=" << plan.samplesPerPixel;
+    std::cout << " for " << plan.holePixels << " hole pixels in " << plan.components << " components, "
+              << plan.boundaryPixels << " boundary pixels" << (plan.meetsTarget ? "" : " (misses the target)") << "\n"
+              << "Predicted " << plan.predictedSeconds << " s, error " << plan.predictedError
+              << "; actual " << plan.actualSeconds << " s, planning " << plan.planSeconds << " s" << std::endl;
+}
 
-        // Convert mask pixel to grayscale to determine if it's a hole
-        const float maskGray = rgbToGrayscaleLinear(maskData[i], maskData[i], maskData[i]);
+// Fill methods of the CLI that map to a single engine
+bool parseFillMethod(const std::string& name, holefill::FillMethod& method) {
+    if (name == "exact") method = holefill::FillMethod::Exact;
+    else if (name == "approx") method = holefill::FillMethod::Approximate;
+    else if (name == "search") method = holefill::FillMethod::Search;
+    else if (name == "adaptive") method = holefill::FillMethod::Adaptive;
+    else if (name == "stochastic") method = holefill::FillMethod::Stochastic;
+    else if (name == "dualtree") method = holefill::FillMethod::DualTree;
+    else if (name == "multires") method = holefill::FillMethod::Multiresolution;
+    else if (name == "hybrid") method = holefill::FillMethod::Hybrid;
+    else return false;
+    return true;
+}
 
-        // Carve out hole if mask grayscale < 0.5
-        grayscaleImage[i] = (maskGray < 0.5f) ? -1.0f : grayscale;
+// --stream <width> <height> <format> <fill_method> (<mask.png> | --mask-stream <path>) [--memory-budget <MiB>]
+int runStreamMode(const int argc, const char** const argv) {
+    StreamConfig config;
+    config.width = std::atoi(argv[2]);
+    config.height = std::atoi(argv[3]);
+    if (config.width <= 0 || config.height <= 0) {
+        std::cerr << "Invalid frame size: " << argv[2] << "x" << argv[3] << "\n";
+        return 1;
+    }
+    if (!parseStreamFormat(argv[4], config.format)) {
+        std::cerr << "Invalid stream format: " << argv[4] << "\n";
+        return 1;
+    }
+    if (!parseFillMethod(argv[5], config.fill.method)) {
+        std::cerr << "Invalid fill method: " << argv[5] << "\n";
+        return 1;
     }
+    config.fill.weightFunc = defaultWeightFunction;
 
-    // Fill the hole using the selected method
-    if (fillMethod == "exact") {
-        holefill::fill(grayscaleImage.data(), width, height, defaultWeightFunction);
-    } else if (fillMethod == "approx") {
-        holefill::fillApproximate(grayscaleImage.data(), width, height);
-    } else if (fillMethod == "search") {
-        holefill::fillExactWithSearch(grayscaleImage.data(), width, height, defaultWeightFunction, 100);
+    int next = 7;
+    std::FILE* maskStream = nullptr;
+    if (std::string(argv[6]) == "--mask-stream") {
+        if (argc < 8 || !(maskStream = std::fopen(argv[7], "rb"))) {
+            std::cerr << "Failed to open mask stream.\n";
+            return 1;
+        }
+        config.maskStream = maskStream;
+        next = 8;
     } else {
-        std::cerr << "Invalid fill method: " << fillMethod << "\n";
-        stbi_image_free(const_cast<unsigned char*>(imageData));
-        stbi_image_free(const_cast<unsigned char*>(maskData));
+        int width, height;
+        unsigned char* const maskData = stbi_load(argv[6], &width, &height, nullptr, 1);
+        if (!maskData || width != config.width || height != config.height) {
+            if (maskData) stbi_image_free(maskData);
+            std::cerr << "Failed to load a mask of the frame size.\n";
+            return 1;
+        }
+        const size_t pixels = static_cast<size_t>(width) * height;
+        config.mask.resize(pixels);
+        for (size_t i = 0; i < pixels; ++i) config.mask[i] = srgbToLinearTable()[maskData[i]] < 0.5f;
+        stbi_image_free(maskData);
+    }
+
+    if (argc >= next + 2 && std::string(argv[next]) == "--memory-budget") {
+        config.fill.options.memoryBudget = static_cast<size_t>(std::atof(argv[next + 1]) * 1024.0 * 1024.0);
+    }
+
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    const int result = runStream(config, stdin, stdout);
+    if (maskStream) std::fclose(maskStream);
+    return result;
+}
+
+// Options following the positional arguments, each with one value. Returns false after reporting an error.
+bool parseOptions(const int argc, const char** const argv, const int first, holefill::FillOptions& options,
+                  std::vector<MaskStep>& maskSteps, holefill::FillTarget& target, bool& budgeted) {
+    for (int i = first; i < argc; i += 2) {
+        const std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << option << "\n";
+            return false;
+        }
+        if (option == "--memory-budget") {
+            options.memoryBudget = static_cast<size_t>(std::atof(argv[i + 1]) * 1024.0 * 1024.0);
+            budgeted = true;
+        } else if (option == "--tolerance") {
+            target.tolerance = static_cast<float>(std::atof(argv[i + 1]));
+        } else if (option == "--latency") {
+            target.latency = std::atof(argv[i + 1]);
+        } else if (option == "--dilate" || option == "--erode" || option == "--min-area") {
+            const MaskStep::Kind kind = option == "--dilate" ? MaskStep::Kind::Dilate
+                : option == "--erode" ? MaskStep::Kind::Erode : MaskStep::Kind::MinArea;
+            maskSteps.push_back({kind, static_cast<size_t>(std::max(0LL, std::atoll(argv[i + 1])))});
+        } else {
+            std::cerr << "Unknown option: " << option << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// --session <image.png> <fill_method> <masks.txt> [options]: decodes the image once and fills it with
+// every mask of the list, a '<mask.png> <output.png>' line per mask
+int runSessionMode(const int argc, const char** const argv) {
+    const auto start = std::chrono::steady_clock::now();
+
+    holefill::FillJob parameters;
+    if (!parseFillMethod(argv[3], parameters.method)) {
+        std::cerr << "Invalid fill method for a session: " << argv[3] << "\n";
         return 1;
     }
+    parameters.weightFunc = defaultWeightFunction;
 
-    // Save output: convert float image [0,1] to 8-bit grayscale for writing
-    std::vector<unsigned char> outputImage(width * height);
-    for (int i = 0; i < width * height; ++i) {
-        const float linearValue = (grayscaleImage[i] < 0.0f) ? 0.0f : grayscaleImage[i];
-        const float srgbValue = linearToSrgb(linearValue);
-        const float clamped = std::min(1.0f, std::max(0.0f, srgbValue));
-        outputImage[i] = static_cast<unsigned char>(clamped * 255.0f);
+    std::vector<MaskStep> maskSteps;
+    holefill::FillTarget target;
+    bool budgeted = false;
+    if (!parseOptions(argc, argv, 5, parameters.options, maskSteps, target, budgeted)) {
+        return 1;
     }
 
-    if (!stbi_write_png(outputPath, width, height, 1, outputImage.data(), static_cast<int>(width))) {
-        std::cerr << "Failed to write output image.\n";
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::ifstream list(argv[4]);
+    if (!list) {
+        std::cerr << "Failed to open mask list: " << argv[4] << "\n";
         return 1;
     }
+    std::string text;
+    for (size_t line = 1; std::getline(list, text); ++line) {
+        std::istringstream fields(text);
+        std::string maskPath, outputPath;
+        if (!(fields >> maskPath) || maskPath[0] == '#') continue;
+        if (!(fields >> outputPath)) {
+            std::cerr << argv[4] << ":" << line << ": expected <mask> <output>\n";
+            return 1;
+        }
+        entries.emplace_back(maskPath, outputPath);
+    }
 
-    std::cout << "Output written to: " << outputPath << std::endl;
+    int width, height;
+    unsigned char* const imageData = stbi_load(argv[2], &width, &height, nullptr, 3);  // Force 3 channels
+    if (!imageData) {
+        std::cerr << "Failed to load image.\n";
+        return 1;
+    }
+    const holefill::FillSession session(toGrayscaleLinear(imageData, width, height).data(), width, height);
+    stbi_image_free(imageData);
 
-    stbi_image_free(const_cast<unsigned char*>(imageData));
-    stbi_image_free(const_cast<unsigned char*>(maskData));
+    // Masks are decoded and filled a group at a time, one per hardware thread, so that the outputs
+    // in memory at once stay few however long the list is
+    const size_t groupSize = std::max(1u, std::thread::hardware_concurrency());
+    const uint8_t level = maskHoleLevel();
+    int failures = 0;
+
+    for (size_t first = 0; first < entries.size(); first += groupSize) {
+        const size_t count = std::min(groupSize, entries.size() - first);
+        std::vector<std::optional<holefill::HoleMask>> masks(count);
+        std::vector<std::vector<float>> outputs(count);
+        std::vector<holefill::FillStats> stats(count);
+        std::vector<holefill::SessionMask> fills;
+        std::vector<size_t> filled;
+
+        for (size_t i = 0; i < count; ++i) {
+            const std::string& maskPath = entries[first + i].first;
+            int maskWidth, maskHeight;
+            unsigned char* const maskData = stbi_load(maskPath.c_str(), &maskWidth, &maskHeight, nullptr, 1);
+            if (!maskData || maskWidth != width || maskHeight != height) {
+                if (maskData) stbi_image_free(maskData);
+                std::cerr << "Failed to load a mask of the image size: " << maskPath << "\n";
+                ++failures;
+                continue;
+            }
+            masks[i] = holefill::HoleMask::threshold(maskData, width, height, level);
+            stbi_image_free(maskData);
+            for (const MaskStep& step : maskSteps) applyMaskStep(step, *masks[i]);
+
+            outputs[i].resize(static_cast<size_t>(width) * height);
+            fills.push_back({&*masks[i], outputs[i].data(), budgeted ? &stats[i] : nullptr});
+            filled.push_back(i);
+        }
+
+        session.fill(fills, parameters);
+
+        for (size_t f = 0; f < fills.size(); ++f) {
+            const size_t i = filled[f];
+            const std::string& outputPath = entries[first + i].second;
+            if (fills[f].error) {
+                try {
+                    std::rethrow_exception(fills[f].error);
+                } catch (const std::exception& e) {
+                    std::cerr << "Failed to fill " << entries[first + i].first << ": " << e.what() << "\n";
+                }
+                ++failures;
+                continue;
+            }
+            if (!writeGrayscalePng(outputPath.c_str(), outputs[i].data(), width, height)) {
+                std::cerr << "Failed to write output image: " << outputPath << "\n";
+                ++failures;
+                continue;
+            }
+            std::cout << "Output written to: " << outputPath << std::endl;
+            if (budgeted) {
+                std::cout << "Peak scratch memory: " << stats[i].peakScratchBytes << " bytes"
+                          << (stats[i].degraded ? " (degraded to fit the budget)" : "") << std::endl;
+            }
+        }
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Filled " << (entries.size() - failures) << " of " << entries.size() << " masks in "
+              << seconds << " s" << std::endl;
+    return failures ? 1 : 0;
+}
+
+int run(const int argc, const char** const argv) {
+    if (argc >= 7 && std::string(argv[1]) == "--stream") {
+        return runStreamMode(argc, argv);
+    }
+
+    if (argc >= 5 && std::string(argv[1]) == "--session") {
+        return runSessionMode(argc, argv);
+    }
+
+    if (argc >= 2 && std::string(argv[1]) == "--worker") {
+        // Scratch memory is kept between jobs, so later jobs skip the allocator and page faults
+        holefill::Arena arena;
+        holefill::FillOptions options;
+        options.upstream = &arena;
+        return runWorker([&](const FillJobSpec& job) {
+            arena.reset();
+            return fillImage(job.imagePath.c_str(), job.maskPath.c_str(), job.outputPath.c_str(), job.method, options);
+        });
+    }
+
+    if (argc >= 4 && std::string(argv[1]) == "--coordinator") {
+        const std::string claimDir = (argc >= 6 && std::string(argv[4]) == "--claim-dir") ? argv[5] : "";
+        return runCoordinator(argv[0], argv[2], static_cast<size_t>(std::max(1, std::atoi(argv[3]))), claimDir,
+                              estimateJobCost);
+    }
+
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " [--isa <isa>] <image.png> <mask.png> <output.png> <fill_method> [--memory-budget <MiB>]\n"
+                  << "                [--dilate <px>] [--erode <px>] [--min-area <px>] [--tolerance <value>] [--latency <s>]\n"
+                  << "       " << argv[0] << " [--isa <isa>] --session <image.png> <fill_method> <masks.txt> [--memory-budget <MiB>]\n"
+                  << "                [--dilate <px>] [--erode <px>] [--min-area <px>]\n"
+                  << "       " << argv[0] << " [--isa <isa>] --coordinator <manifest> <workers> [--claim-dir <dir>]\n"
+                  << "       " << argv[0] << " [--isa <isa>] --stream <width> <height> <format> <fill_method>\n"
+                  << "                (<mask.png> | --mask-stream <path>) [--memory-budget <MiB>]\n"
+                  << "Fill methods:\n"
+                  << "  exact     - Exact fill using default weight function\n"
+                  << "  approx    - Approximate fill using windowed weight function\n"
+                  << "  search    - Exact fill with search using default weight function\n"
+                  << "  adaptive  - Exact fill evaluated sparsely and interpolated in smooth hole interiors\n"
+                  << "  stochastic - Monte Carlo estimate of the exact fill with a fixed sample budget\n"
+                  << "  dualtree  - Exact fill with dual-tree search over hole and boundary pixels\n"
+                  << "  multires  - Exact fill of the image reduced by 2, exact again in a band near the boundary\n"
+                  << "  hybrid    - Exact fill interpolated from a sparse lattice, refined exactly in 16x16 tiles where\n"
+                  << "              checks of the exact fill differ by more than --tolerance (default 0.01)\n"
+                  << "  auto      - Fastest of the above predicted to stay within --tolerance (default 0.01) of\n"
+                  << "              the exact fill and within --latency seconds, chosen by a cost model\n"
+                  << "Session mode decodes the image once and fills it with every '<mask> <output>' line of the\n"
+                  << "list, in parallel across masks. Every fill method except auto is available.\n"
+                  << "Coordinator mode runs every '<image> <mask> <output> <fill_method>' line of the manifest\n"
+                  << "on a pool of worker processes. With --claim-dir, coordinators on several machines can share\n"
+                  << "one manifest through a shared directory.\n"
+                  << "With --memory-budget, the fill keeps its scratch memory within the budget, switching to a\n"
+                  << "leaner algorithm if needed, and reports its peak scratch memory.\n"
+                  << "--dilate and --erode grow and shrink the holes of the mask by a number of pixels, and\n"
+                  << "--min-area drops holes of fewer pixels, in the order given, before the fill.\n"
+                  << "Stream mode fills raw frames from stdin and writes them to stdout. Formats: gray8, rgb24,\n"
+                  << "gray16 (little-endian) and f32 (linear). The mask is a PNG applied to every frame, or a stream\n"
+                  << "of gray8 mask frames read alongside the image frames.\n"
+                  << "--isa forces the instruction set of the hot loops: scalar, sse4.2, avx2 or avx512.\n"
+                  << "By default the widest one the CPU supports is used.\n";
+        return 1;
+    }
+
+    holefill::FillStats stats;
+    holefill::FillOptions options;
+    std::vector<MaskStep> maskSteps;
+    holefill::FillTarget target;
+    bool budgeted = false;
+    if (!parseOptions(argc, argv, 5, options, maskSteps, target, budgeted)) {
+        return 1;
+    }
+    if (budgeted) options.stats = &stats;
+
+    const char* const outputPath = argv[3];
+    holefill::FillPlan plan;
+    holefill::HybridFillReport report;
+    if (fillImage(argv[1], argv[2], outputPath, argv[4], options, maskSteps, target, &plan, &report) != 0) {
+        return 1;
+    }
+
+    std::cout << "Output written to: " << outputPath << std::endl;
+    if (std::string(argv[4]) == "auto") printPlan(plan);
+    if (std::string(argv[4]) == "hybrid") {
+        std::cout << "Refined " << report.refinedTiles << " of " << report.tiles << " tiles, "
+                  << 100.0 * report.refinedFraction() << "% of " << report.holePixels << " hole pixels, from "
+                  << report.samples << " exact samples" << std::endl;
+    }
+    if (budgeted) {
+        std::cout << "Peak scratch memory: " << stats.peakScratchBytes << " bytes"
+                  << (stats.degraded ? " (degraded to fit the budget)" : "") << std::endl;
+    }
     return 0;
 }
+
+int main(const int argc, const char** const argv) {
+    if (argc >= 3 && std::string(argv[1]) == "--isa") {
+        holefill::Isa isa;
+        if (!holefill::parseIsa(argv[2], isa) || !holefill::selectIsa(isa)) {
+            std::cerr << "Unsupported instruction set: " << argv[2] << "\n";
+            return 1;
+        }
+
+        // Worker processes started by the coordinator inherit the choice through the environment
+#ifdef _WIN32
+        _putenv_s("HOLEFILL_ISA", argv[2]);
+#else
+        setenv("HOLEFILL_ISA", argv[2], 1);
+#endif
+
+        // Drop the option, keeping the program name in front
+        argv[2] = argv[0];
+        return run(argc - 2, argv + 2);
+    }
+
+    return run(argc, argv);
+}
@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <bit>
+
+#include "occupancy.h"
+#include "kernels.h"
+#include "parallel.h"
+
+namespace holefill {
+
+TileOccupancy::TileOccupancy(const float* const image, const int32_t width, const int32_t height,
+                             std::pmr::memory_resource* const resource)
+    : width(width), height(height),
+      tilesX((width + tileSize - 1) / tileSize), tilesY((height + tileSize - 1) / tileSize),
+      wordsPerRow((static_cast<size_t>(tilesX) + 63) / 64),
+      bits(wordsPerRow * tilesY, 0, resource) {
+    const Kernels& k = kernels();
+
+    // Each task owns one row of tiles. A tile is not scanned again once a hole pixel was found in it.
+    parallelFor(static_cast<size_t>(tilesY), [&](const size_t ty) {
+        uint64_t* const words = &bits[ty * wordsPerRow];
+        int32_t remaining = tilesX;
+        const int32_t y1 = std::min(height, static_cast<int32_t>(ty + 1) * tileSize);
+
+        for (int32_t y = static_cast<int32_t>(ty) * tileSize; y < y1 && remaining > 0; ++y) {
+            const float* const row = image + static_cast<size_t>(y) * width;
+            for (int32_t tx = 0; tx < tilesX; ++tx) {
+                if ((words[tx >> 6] >> (tx & 63)) & 1u) continue;
+
+                const int32_t x0 = tx * tileSize;
+                const size_t length = static_cast<size_t>(std::min(tileSize, width - x0));
+                if (k.findNegative(row + x0, length) < length) {
+                    words[tx >> 6] |= uint64_t{1} << (tx & 63);
+                    --remaining;
+                }
+            }
+        }
+    });
+
+    for (const uint64_t word : bits) occupiedCount += std::popcount(word);
+}
+
+} // namespace holefill
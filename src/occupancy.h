@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace holefill {
+
+// Coarse level of the hole mask: one bit per tileSize x tileSize tile that contains a hole pixel.
+// Built in one parallel pass over the image; later scans only touch the occupied tiles, which on
+// huge images with a few small holes is a tiny fraction of the image.
+struct TileOccupancy {
+    static constexpr int32_t tileSize = 64;
+
+    int32_t width;
+    int32_t height;
+    int32_t tilesX;
+    int32_t tilesY;
+    size_t wordsPerRow;             // Rows of tiles start on a word boundary so they can be built concurrently
+    std::pmr::vector<uint64_t> bits;
+    size_t occupiedCount = 0;
+
+    TileOccupancy(const float* image, int32_t width, int32_t height,
+                  std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    bool occupied(const int32_t tx, const int32_t ty) const {
+        return (bits[ty * wordsPerRow + (tx >> 6)] >> (tx & 63)) & 1u;
+    }
+
+    bool empty() const { return occupiedCount == 0; }
+
+    // Calls visit(x0, x1) for every run of consecutive occupied tiles in tile row ty, as the pixel
+    // columns [x0, x1) they cover
+    template <typename Visit>
+    void forEachRun(const int32_t ty, const Visit& visit) const {
+        for (int32_t tx = 0; tx < tilesX;) {
+            if (!occupied(tx, ty)) {
+                ++tx;
+                continue;
+            }
+            const int32_t first = tx;
+            while (tx < tilesX && occupied(tx, ty)) ++tx;
+            visit(first * tileSize, tx == tilesX ? width : tx * tileSize);
+        }
+    }
+
+    // Calls visit(x, y) for every pixel of the occupied tiles in row-major order
+    template <typename Visit>
+    void forEachPixel(const Visit& visit) const {
+        for (int32_t ty = 0; ty < tilesY; ++ty) {
+            const int32_t y1 = ty == tilesY - 1 ? height : (ty + 1) * tileSize;
+            for (int32_t y = ty * tileSize; y < y1; ++y) {
+                forEachRun(ty, [&](const int32_t x0, const int32_t x1) {
+                    for (int32_t x = x0; x < x1; ++x) visit(x, y);
+                });
+            }
+        }
+    }
+};
+
+} // namespace holefill
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+namespace holefill {
+
+// Threads started once and shared by every fill of the process
+class ThreadPool {
+public:
+    explicit ThreadPool(const size_t threadCount) {
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([this] { work(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (std::thread& thread : threads) thread.join();
+    }
+
+    size_t size() const { return threads.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        available.notify_one();
+    }
+
+private:
+    void work() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+ThreadPool& threadPool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+void submitTask(std::function<void()> task) {
+    threadPool().submit(std::move(task));
+}
+
+// Depth of the SerialScopes alive on this thread
+thread_local int serialDepth = 0;
+
+SerialScope::SerialScope() {
+    ++serialDepth;
+}
+
+SerialScope::~SerialScope() {
+    --serialDepth;
+}
+
+thread_local ThreadObserver* threadObserver = nullptr;
+
+ThreadObserver* setThreadObserver(ThreadObserver* const observer) {
+    ThreadObserver* const previous = threadObserver;
+    threadObserver = observer;
+    return previous;
+}
+
+// Shared between the caller of parallelFor and the helper tasks it submits. Helpers that only
+// start after all indices were handed out find nothing to do, so the state must outlive the call.
+struct ParallelJob {
+    size_t count;
+    const std::function<void(size_t)>* body;
+    ThreadObserver* observer;
+    std::atomic<size_t> next{0};
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    size_t done = 0;
+    size_t observedHelpers = 0;  // Helpers between helperBegin() and helperEnd()
+    std::exception_ptr error;
+
+    void run() {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                (*body)(i);
+            } catch (...) {
+                const std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+
+            const std::lock_guard<std::mutex> lock(mutex);
+            if (++done == count) finished.notify_all();
+        }
+    }
+
+    // Runs bodies on a pool thread. The observer may be gone once all bodies are done, so a helper
+    // only begins observing while the caller is still waiting.
+    void help() {
+        if (!observer) {
+            run();
+            return;
+        }
+
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            if (done == count) return;
+            ++observedHelpers;
+        }
+        ThreadObserver* const previous = setThreadObserver(observer);
+        observer->helperBegin();
+        run();
+        observer->helperEnd();
+        setThreadObserver(previous);
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        --observedHelpers;
+        finished.notify_all();
+    }
+};
+
+void parallelFor(const size_t count, const std::function<void(size_t)>& body) {
+    ThreadPool& pool = threadPool();
+    const size_t threadCount = serialDepth > 0 ? 1 : std::min(pool.size(), count);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+
+    const auto job = std::make_shared<ParallelJob>();
+    job->count = count;
+    job->body = &body;
+    job->observer = threadObserver;
+    for (size_t t = 1; t < threadCount; ++t) {
+        pool.submit([job] { job->help(); });
+    }
+    job->run();
+
+    // Only bodies already running are waited for, never queued helpers, so a parallelFor called
+    // from a pool thread cannot deadlock when every other pool thread is busy
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&] { return job->done == count && job->observedHelpers == 0; });
+    if (job->error) std::rethrow_exception(job->error);
+}
+
+} // namespace holefill
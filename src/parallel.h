@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace holefill {
+
+/**
+ * @brief Runs body(i) for every i in [0, count) on the library's thread pool.
+ *
+ * Indices are handed out one at a time, so bodies of uneven cost balance themselves.
+ * The calling thread takes part in the work and the function returns once every body has finished.
+ * It may be called from a pool thread. If bodies throw, the first exception is rethrown after all
+ * bodies have finished.
+ */
+void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+/**
+ * @brief Runs task on the library's thread pool, which has one thread per hardware thread.
+ */
+void submitTask(std::function<void()> task);
+
+/**
+ * @brief Follows the work that pool threads do on behalf of a thread, e.g. to count hardware events.
+ *
+ * While an observer is installed on a thread, every pool thread helping with one of that thread's
+ * parallelFor calls installs the same observer for the duration, so nested loops are followed too,
+ * and calls helperBegin() before and helperEnd() after running bodies. parallelFor does not return
+ * before every helper that began has ended.
+ */
+class ThreadObserver {
+public:
+    virtual void helperBegin() = 0;
+    virtual void helperEnd() = 0;
+
+protected:
+    ~ThreadObserver() = default;
+};
+
+/**
+ * @brief Installs observer on the calling thread, or none when null. Returns the observer installed before.
+ */
+ThreadObserver* setThreadObserver(ThreadObserver* observer);
+
+/**
+ * @brief While alive, parallelFor calls made by the constructing thread run their bodies inline.
+ *
+ * Used to run many small fills side by side, one per thread, without each of them spreading
+ * its own tiny loops over the pool.
+ */
+class SerialScope {
+public:
+    SerialScope();
+    ~SerialScope();
+
+    SerialScope(const SerialScope&) = delete;
+    SerialScope& operator=(const SerialScope&) = delete;
+};
+
+} // namespace holefill
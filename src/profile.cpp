@@ -0,0 +1,152 @@
+#include "profile.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace holefill {
+
+const char* phaseName(const FillPhase phase) {
+    switch (phase) {
+        case FillPhase::Detection: return "detection";
+        case FillPhase::Boundary: return "boundary";
+        case FillPhase::IndexBuild: return "index_build";
+        case FillPhase::Query: return "query";
+        case FillPhase::WriteBack: return "write_back";
+    }
+    return "unknown";
+}
+
+#ifdef __linux__
+
+// Counters of one thread, kept open for the lifetime of the thread
+struct ThreadEvents {
+    std::array<int, hardwareEventCount> fds;
+
+    ThreadEvents() {
+        constexpr uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const std::pair<uint32_t, uint64_t> configs[hardwareEventCount] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, l1dReadMiss},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+
+        for (size_t e = 0; e < hardwareEventCount; ++e) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = configs[e].first;
+            attr.config = configs[e].second;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+    }
+
+    ~ThreadEvents() {
+        for (const int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    // Cycles are the one event every PMU has; without them nothing is counted
+    bool available() const { return fds[0] >= 0; }
+
+    void read(EventCounts& counts) const {
+        for (size_t e = 0; e < hardwareEventCount; ++e) {
+            uint64_t value[3] = {0, 0, 0};  // Count, time enabled, time running
+            counts[e] = 0;
+            if (fds[e] < 0 || ::read(fds[e], value, sizeof(value)) != sizeof(value) || value[2] == 0) continue;
+            // Scale up counts of events that shared the PMU with others
+            counts[e] = value[2] < value[1]
+                ? static_cast<uint64_t>(static_cast<double>(value[0]) * value[1] / value[2])
+                : value[0];
+        }
+    }
+};
+
+bool readThreadEvents(EventCounts& counts) {
+    thread_local const ThreadEvents events;
+    if (!events.available()) return false;
+    events.read(counts);
+    return true;
+}
+
+#else
+
+bool readThreadEvents(EventCounts&) {
+    return false;
+}
+
+#endif
+
+FillProfile::FillProfile(FillStats* const stats, const bool countEvents) : stats(stats) {
+    if (!stats) return;
+    counting = countEvents && readThreadEvents(phaseEvents);
+    if (counting) previousObserver = setThreadObserver(this);
+    phaseStart = std::chrono::steady_clock::now();
+}
+
+FillProfile::~FillProfile() {
+    if (!stats) return;
+    finishPhase();
+    if (counting) setThreadObserver(previousObserver);
+
+    for (size_t p = 0; p < fillPhaseCount; ++p) {
+        PhaseStats& phaseStats = stats->phases[p];
+        phaseStats.seconds += seconds[p];
+        phaseStats.cycles += events[p][0];
+        phaseStats.instructions += events[p][1];
+        phaseStats.l1dMisses += events[p][2];
+        phaseStats.llcMisses += events[p][3];
+        phaseStats.branchMisses += events[p][4];
+    }
+    stats->eventsCounted = counting;
+}
+
+void FillProfile::enter(const FillPhase next) {
+    if (!stats) return;
+    finishPhase();
+    phase = static_cast<size_t>(next);
+}
+
+void FillProfile::finishPhase() {
+    const auto now = std::chrono::steady_clock::now();
+    seconds[phase] += std::chrono::duration<double>(now - phaseStart).count();
+    phaseStart = now;
+
+    if (counting) {
+        EventCounts current;
+        readThreadEvents(current);
+        add(phase, phaseEvents, current);
+        phaseEvents = current;
+    }
+}
+
+void FillProfile::add(const size_t p, const EventCounts& begin, const EventCounts& end) {
+    for (size_t e = 0; e < hardwareEventCount; ++e) {
+        if (end[e] > begin[e]) events[p][e] += end[e] - begin[e];
+    }
+}
+
+// A pool thread helps with one parallel loop at a time, so one start per thread suffices
+thread_local EventCounts helperStart;
+thread_local bool helperCounting = false;
+
+void FillProfile::helperBegin() {
+    helperCounting = readThreadEvents(helperStart);
+}
+
+void FillProfile::helperEnd() {
+    if (!helperCounting) return;
+    EventCounts current;
+    readThreadEvents(current);
+    add(phase, helperStart, current);
+}
+
+} // namespace holefill
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "holefill.h"
+#include "parallel.h"
+
+namespace holefill {
+
+// Hardware events counted per phase, in the order of the PhaseStats fields
+constexpr size_t hardwareEventCount = 5;
+using EventCounts = std::array<uint64_t, hardwareEventCount>;
+
+// Reads the events counted so far on the calling thread, opening its counters on first use.
+// Returns false when the counters are unavailable.
+bool readThreadEvents(EventCounts& counts);
+
+// Time and hardware events of the phases of one fill call, written to FillStats on destruction.
+// The calling thread measures phases from one enter() to the next. Pool threads helping with
+// parallel loops of the call report their events through the ThreadObserver interface, and are
+// credited to the phase that is current when they finish, which is the phase of their loop.
+class FillProfile : public ThreadObserver {
+public:
+    FillProfile(FillStats* stats, bool countEvents);
+    ~FillProfile();
+
+    FillProfile(const FillProfile&) = delete;
+    FillProfile& operator=(const FillProfile&) = delete;
+
+    // Ends the current phase and starts the given one
+    void enter(FillPhase phase);
+
+    void helperBegin() override;
+    void helperEnd() override;
+
+private:
+    void finishPhase();
+    void add(size_t phase, const EventCounts& begin, const EventCounts& end);
+
+    FillStats* const stats;
+    bool counting = false;
+    ThreadObserver* previousObserver = nullptr;
+
+    std::atomic<size_t> phase{0};
+    std::chrono::steady_clock::time_point phaseStart;
+    EventCounts phaseEvents{};
+    std::array<double, fillPhaseCount> seconds{};
+    std::array<std::array<std::atomic<uint64_t>, hardwareEventCount>, fillPhaseCount> events{};
+};
+
+} // namespace holefill
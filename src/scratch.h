@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+
+#include "holefill.h"
+#include "profile.h"
+
+namespace holefill {
+
+// Counts the scratch memory of one fill call against its budget. Allocations are made from
+// several threads by the parallel engines, so the counters are atomic.
+class ScratchResource : public std::pmr::memory_resource {
+public:
+    explicit ScratchResource(const FillOptions& options)
+        : upstream(options.upstream ? options.upstream : std::pmr::new_delete_resource()),
+          budget(options.memoryBudget ? options.memoryBudget : std::numeric_limits<size_t>::max()),
+          stats(options.stats), cancel(options.cancel),
+          profile(options.stats, options.countEvents) {
+        if (stats) *stats = FillStats{};
+    }
+
+    ~ScratchResource() override {
+        if (stats) stats->peakScratchBytes = peak.load();
+    }
+
+    // Accounts for memory that is allocated elsewhere, e.g. inside nanoflann
+    void charge(const size_t bytes) {
+        const size_t previous = current.fetch_add(bytes);
+        if (previous + bytes > budget || previous + bytes < previous) {
+            current.fetch_sub(bytes);
+            throw MemoryBudgetExceeded();
+        }
+
+        size_t highest = peak.load();
+        while (previous + bytes > highest && !peak.compare_exchange_weak(highest, previous + bytes)) {}
+    }
+
+    void release(const size_t bytes) {
+        current.fetch_sub(bytes);
+    }
+
+    // Records that the engine switched to a leaner algorithm
+    void degrade() {
+        if (stats) stats->degraded = true;
+    }
+
+    // Starts the next phase of the fill for FillStats::phases
+    void enterPhase(const FillPhase phase) {
+        profile.enter(phase);
+    }
+
+    // Throws FillCancelled once the caller has requested stop. Engines call this between units of
+    // work, before a pixel is written, so cancelled fills leave unfilled pixels negative.
+    void checkCancelled() const {
+        if (cancelled()) throw FillCancelled();
+    }
+
+    // For engines that must restore the image before checkCancelled throws
+    bool cancelled() const {
+        return cancel.stop_requested();
+    }
+
+private:
+    void* do_allocate(const size_t bytes, const size_t alignment) override {
+        charge(bytes);
+        try {
+            return upstream->allocate(bytes, alignment);
+        } catch (...) {
+            release(bytes);
+            throw;
+        }
+    }
+
+    void do_deallocate(void* const pointer, const size_t bytes, const size_t alignment) override {
+        upstream->deallocate(pointer, bytes, alignment);
+        release(bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* const upstream;
+    const size_t budget;
+    FillStats* const stats;
+    const std::stop_token cancel;
+    FillProfile profile;
+    std::atomic<size_t> current{0};
+    std::atomic<size_t> peak{0};
+};
+
+// Holds a charge for memory allocated outside of the scratch resource for the lifetime of a scope
+struct ScratchCharge {
+    ScratchResource& scratch;
+    const size_t bytes;
+
+    ScratchCharge(ScratchResource& scratch, const size_t bytes) : scratch(scratch), bytes(bytes) {
+        scratch.charge(bytes);
+    }
+
+    ~ScratchCharge() {
+        scratch.release(bytes);
+    }
+
+    ScratchCharge(const ScratchCharge&) = delete;
+    ScratchCharge& operator=(const ScratchCharge&) = delete;
+};
+
+// Rough size of a nanoflann index over n points: one index per point plus the nodes
+inline size_t nanoflannIndexBytes(const size_t n, const size_t leafSize) {
+    return n * sizeof(size_t) + (2 * n / leafSize + 1) * 64;
+}
+
+} // namespace holefill
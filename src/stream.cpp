@@ -0,0 +1,273 @@
+#include "stream.h"
+#include "color.h"
+#include "arena.h"
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+
+namespace {
+
+// Blocking queue handing frames from one pipeline stage to the next
+template <typename T>
+class StageQueue {
+public:
+    void push(T item) {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(std::move(item));
+        }
+        available.notify_one();
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        return true;
+    }
+
+    void close() {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        available.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+// Frames in flight: one being decoded, one being filled and one being written
+constexpr size_t framesInFlight = 3;
+
+struct Frame {
+    std::vector<unsigned char> bytes;      // Raw frame as read, rewritten at the holes before writing
+    std::vector<unsigned char> maskBytes;  // Raw mask frame, only with a mask stream
+    std::vector<unsigned char> holes;      // Non-zero at holes, only with a mask stream
+    std::vector<float> planes;             // One linear plane per channel, holes negative
+};
+
+size_t channelCount(const StreamFormat format) {
+    return format == StreamFormat::Rgb24 ? 3 : 1;
+}
+
+size_t bytesPerSample(const StreamFormat format) {
+    switch (format) {
+        case StreamFormat::Gray16: return 2;
+        case StreamFormat::F32: return 4;
+        default: return 1;
+    }
+}
+
+// 16-bit sRGB to linear, tabulated like the 8-bit table
+std::vector<float> makeGray16Table() {
+    std::vector<float> table(65536);
+    for (size_t i = 0; i < table.size(); ++i) table[i] = srgbToLinear(i / 65535.0f);
+    return table;
+}
+
+uint16_t linearToSrgb16(const float linearValue) {
+    const float srgbValue = linearToSrgb(linearValue < 0.0f ? 0.0f : linearValue);
+    const float clamped = std::min(1.0f, std::max(0.0f, srgbValue));
+    return static_cast<uint16_t>(clamped * 65535.0f + 0.5f);
+}
+
+// Fills the planes of the frame from its bytes, writing -1 at the holes
+void decodeFrame(const StreamFormat format, const size_t pixels, const unsigned char* const holes,
+                 const std::vector<float>& gray16Table, Frame& frame) {
+    const std::array<float, 256>& table = srgbToLinearTable();
+    const unsigned char* const bytes = frame.bytes.data();
+    float* const planes = frame.planes.data();
+
+    switch (format) {
+        case StreamFormat::Gray8:
+            for (size_t i = 0; i < pixels; ++i) planes[i] = holes[i] ? -1.0f : table[bytes[i]];
+            break;
+        case StreamFormat::Rgb24:
+            for (size_t i = 0; i < pixels; ++i) {
+                for (size_t c = 0; c < 3; ++c) {
+                    planes[c * pixels + i] = holes[i] ? -1.0f : table[bytes[i * 3 + c]];
+                }
+            }
+            break;
+        case StreamFormat::Gray16:
+            for (size_t i = 0; i < pixels; ++i) {
+                planes[i] = holes[i] ? -1.0f : gray16Table[bytes[i * 2] | (bytes[i * 2 + 1] << 8)];
+            }
+            break;
+        case StreamFormat::F32:
+            std::memcpy(planes, bytes, pixels * sizeof(float));
+            for (size_t i = 0; i < pixels; ++i) {
+                if (holes[i]) planes[i] = -1.0f;
+            }
+            break;
+    }
+}
+
+// Writes the filled values back into the bytes of the frame, at the holes only
+void encodeFrame(const StreamFormat format, const size_t pixels, const unsigned char* const holes, Frame& frame) {
+    unsigned char* const bytes = frame.bytes.data();
+    const float* const planes = frame.planes.data();
+
+    for (size_t i = 0; i < pixels; ++i) {
+        // f32 frames may carry holes of their own, outside the mask
+        if (!holes[i] && format != StreamFormat::F32) continue;
+
+        switch (format) {
+            case StreamFormat::Gray8:
+                bytes[i] = linearToSrgb8(planes[i]);
+                break;
+            case StreamFormat::Rgb24:
+                for (size_t c = 0; c < 3; ++c) bytes[i * 3 + c] = linearToSrgb8(planes[c * pixels + i]);
+                break;
+            case StreamFormat::Gray16: {
+                const uint16_t value = linearToSrgb16(planes[i]);
+                bytes[i * 2] = static_cast<unsigned char>(value & 0xff);
+                bytes[i * 2 + 1] = static_cast<unsigned char>(value >> 8);
+                break;
+            }
+            case StreamFormat::F32:
+                std::memcpy(bytes + i * sizeof(float), planes + i, sizeof(float));
+                break;
+        }
+    }
+}
+
+} // namespace
+
+bool parseStreamFormat(const std::string& name, StreamFormat& format) {
+    if (name == "gray8") format = StreamFormat::Gray8;
+    else if (name == "rgb24") format = StreamFormat::Rgb24;
+    else if (name == "gray16") format = StreamFormat::Gray16;
+    else if (name == "f32") format = StreamFormat::F32;
+    else return false;
+    return true;
+}
+
+int runStream(const StreamConfig& config, std::FILE* const input, std::FILE* const output) {
+    const size_t pixels = static_cast<size_t>(config.width) * config.height;
+    const size_t channels = channelCount(config.format);
+    const size_t frameBytes = pixels * channels * bytesPerSample(config.format);
+    const std::vector<float> gray16Table = (config.format == StreamFormat::Gray16) ? makeGray16Table() : std::vector<float>();
+
+    StageQueue<std::unique_ptr<Frame>> freeFrames;
+    StageQueue<std::unique_ptr<Frame>> decoded;
+    StageQueue<std::unique_ptr<Frame>> filled;
+    for (size_t i = 0; i < framesInFlight; ++i) {
+        auto frame = std::make_unique<Frame>();
+        frame->bytes.resize(frameBytes);
+        frame->planes.resize(pixels * channels);
+        if (config.maskStream) {
+            frame->maskBytes.resize(pixels);
+            frame->holes.resize(pixels);
+        }
+        freeFrames.push(std::move(frame));
+    }
+
+    const auto holesOf = [&](const Frame& frame) {
+        return config.maskStream ? frame.holes.data() : config.mask.data();
+    };
+
+    std::atomic<bool> failed{false};
+
+    std::thread reader([&] {
+        std::unique_ptr<Frame> frame;
+        while (!failed && freeFrames.pop(frame)) {
+            const size_t read = std::fread(frame->bytes.data(), 1, frameBytes, input);
+            if (read == 0) break;
+            if (read < frameBytes) {
+                std::cerr << "Input ended in the middle of a frame.\n";
+                failed = true;
+                break;
+            }
+
+            if (config.maskStream) {
+                if (std::fread(frame->maskBytes.data(), 1, pixels, config.maskStream) < pixels) {
+                    std::cerr << "Mask stream ended before the frame stream.\n";
+                    failed = true;
+                    break;
+                }
+                const std::array<float, 256>& table = srgbToLinearTable();
+                for (size_t i = 0; i < pixels; ++i) frame->holes[i] = table[frame->maskBytes[i]] < 0.5f;
+            }
+
+            decodeFrame(config.format, pixels, holesOf(*frame), gray16Table, *frame);
+            decoded.push(std::move(frame));
+        }
+        decoded.close();
+    });
+
+    std::thread writer([&] {
+        std::unique_ptr<Frame> frame;
+        while (filled.pop(frame)) {
+            if (!failed) {
+                encodeFrame(config.format, pixels, holesOf(*frame), *frame);
+                if (std::fwrite(frame->bytes.data(), 1, frameBytes, output) < frameBytes) {
+                    std::cerr << "Failed to write output frame.\n";
+                    failed = true;
+                }
+            }
+            freeFrames.push(std::move(frame));
+        }
+    });
+
+    // Scratch memory is kept between frames, so frames after the first neither allocate nor fault in pages
+    holefill::Arena arena;
+    std::vector<holefill::FillJob> jobs(channels, config.fill);
+    for (holefill::FillJob& job : jobs) {
+        job.width = config.width;
+        job.height = config.height;
+        job.variance = nullptr;
+        job.options.stats = nullptr;
+        if (!job.options.upstream) job.options.upstream = &arena;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t frameCount = 0;
+    std::unique_ptr<Frame> frame;
+    while (decoded.pop(frame)) {
+        if (!failed) {
+            arena.reset();
+            for (size_t c = 0; c < channels; ++c) jobs[c].image = frame->planes.data() + c * pixels;
+            holefill::fillBatch(jobs);
+
+            for (const holefill::FillJob& job : jobs) {
+                if (!job.error || failed) continue;
+                try {
+                    std::rethrow_exception(job.error);
+                } catch (const std::exception& e) {
+                    std::cerr << "Frame " << frameCount << ": " << e.what() << "\n";
+                }
+                failed = true;
+            }
+            ++frameCount;
+        }
+        filled.push(std::move(frame));
+    }
+    filled.close();
+
+    reader.join();
+    writer.join();
+    std::fflush(output);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Filled " << frameCount << " frames in " << seconds << " s ("
+              << (seconds > 0.0 ? frameCount / seconds : 0.0) << " frames/s)" << std::endl;
+    return failed ? 1 : 0;
+}
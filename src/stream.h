@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "holefill_batch.h"
+
+// Sample layout of a raw frame, named after the matching ffmpeg pixel formats
+enum class StreamFormat {
+    Gray8,   // gray: one sRGB byte per pixel
+    Rgb24,   // rgb24: three sRGB bytes per pixel, each channel filled separately
+    Gray16,  // gray16le: one little-endian 16-bit sRGB sample per pixel
+    F32      // grayf32: one linear float per pixel in native byte order; negative values are holes too
+};
+
+/**
+ * @brief Parses gray8, rgb24, gray16 or f32. Returns false for any other name.
+ */
+bool parseStreamFormat(const std::string& name, StreamFormat& format);
+
+struct StreamConfig {
+    int32_t width = 0;
+    int32_t height = 0;
+    StreamFormat format = StreamFormat::Gray8;
+    // Engine and parameters every channel of every frame is filled with; image and size are set per frame
+    holefill::FillJob fill;
+    // One byte per pixel, non-zero at holes, applied to every frame when maskStream is null
+    std::vector<unsigned char> mask;
+    // Stream of 8-bit grayscale mask frames, one per image frame, read alongside it; or null
+    std::FILE* maskStream = nullptr;
+};
+
+/**
+ * @brief Fills raw frames read from input and writes them to output until input ends.
+ *
+ * Frames are width * height pixels of the configured format, back to back without headers, as
+ * produced and consumed by 'ffmpeg -f rawvideo'. Mask pixels darker than half the linear intensity
+ * are holes, as for PNG masks. Only hole pixels are rewritten; all others pass through bit for bit.
+ *
+ * Reading and decoding, filling, and encoding and writing run on three threads with three frames in
+ * flight, so the next frame is decoded and the previous one written while the current one is filled.
+ * Scratch memory of the fills comes from an arena kept across frames, unless the config names an upstream.
+ * A summary with the frame rate is written to stderr at the end.
+ *
+ * @return 0 when every frame was filled and written, 1 otherwise
+ */
+int runStream(const StreamConfig& config, std::FILE* input, std::FILE* output);
@@ -0,0 +1,253 @@
+#include "holefill.h"
+#include "holefill_plan.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <filesystem>
+
+namespace {
+
+float defaultWeightFunction(const holefill::Coord& u, const holefill::Coord& v) {
+    const float epsilon = 0.01f;
+    const float zeta = 3.0f;
+    const float dx = static_cast<float>(u.x - v.x);
+    const float dy = static_cast<float>(u.y - v.y);
+    const float distanceSquared = dx * dx + dy * dy;
+    return 1.0f / powf(distanceSquared + epsilon, zeta);
+}
+
+// Smooth synthetic image with a ring-shaped hole of the given thickness in the centre
+std::vector<float> makeWorkload(const int32_t width, const int32_t height, const int32_t radius, const int32_t thickness) {
+    std::vector<float> image(static_cast<size_t>(width) * height);
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            const int32_t dx = x - width / 2;
+            const int32_t dy = y - height / 2;
+            const int32_t inner = std::max(0, radius - thickness);
+            const int32_t distanceSquared = dx * dx + dy * dy;
+            image[static_cast<size_t>(y) * width + x] = (distanceSquared <= radius * radius && distanceSquared >= inner * inner)
+                ? -1.0f
+                : 0.5f + 0.25f * std::sin(x * 0.05f) * std::cos(y * 0.03f);
+        }
+    }
+    return image;
+}
+
+// Best of several runs of fillFunc on fresh copies of the workload, in seconds
+template <typename FillFunc>
+double timeFill(const std::vector<float>& workload, const int repetitions, FillFunc fillFunc) {
+    double best = std::numeric_limits<double>::max();
+    for (int r = 0; r < repetitions; ++r) {
+        std::vector<float> image = workload;
+        const auto start = std::chrono::steady_clock::now();
+        fillFunc(image.data());
+        const auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+// A candidate has to beat the current value by this fraction to replace it, so that timing noise
+// does not move a parameter away from its default
+constexpr double requiredGain = 0.03;
+
+// Times a fill with every candidate value of a leaf size and keeps the fastest one
+void tuneLeafSize(const char* const name, size_t holefill::Tuning::*const field, const std::vector<float>& workload,
+                  const auto& fillFunc) {
+    const size_t initial = holefill::tuning().*field;
+    size_t best = initial;
+    double bestSeconds = timeFill(workload, 3, fillFunc);
+
+    for (const size_t leafSize : {4, 8, 16, 32, 64}) {
+        if (leafSize == initial) continue;
+        holefill::tuning().*field = leafSize;
+        const double seconds = timeFill(workload, 3, fillFunc);
+
+        std::cout << "{\"parameter\": \"" << name << "\", \"value\": " << leafSize
+                  << ", \"seconds\": " << seconds << "}" << std::endl;
+        if (seconds < bestSeconds * (1.0 - requiredGain)) {
+            best = leafSize;
+            bestSeconds = seconds;
+        }
+    }
+
+    holefill::tuning().*field = best;
+    std::cout << "{\"parameter\": \"" << name << "\", \"tuned\": " << best << "}" << std::endl;
+}
+
+// Largest boundary for which fillExactWithSearch is faster scanning every boundary pixel than
+// searching the KD-tree, at the k the command line uses
+void tuneSearchCrossover() {
+    constexpr int32_t size = 1024;
+    constexpr size_t k = 100;
+    holefill::Tuning& parameters = holefill::tuning();
+    size_t crossover = 0;
+
+    for (const int32_t radius : {8, 16, 32, 64, 128, 256}) {
+        const std::vector<float> workload = makeWorkload(size, size, radius, 4);
+        const auto fillFunc = [&](float* image) {
+            holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, k);
+        };
+        const size_t boundary = holefill::planFill(workload.data(), size, size, defaultWeightFunction).boundaryPixels;
+
+        parameters.bruteForceSearchMaxBoundary = 0;
+        const double tree = timeFill(workload, 3, fillFunc);
+        parameters.bruteForceSearchMaxBoundary = std::numeric_limits<size_t>::max();
+        const double brute = timeFill(workload, 3, fillFunc);
+
+        std::cout << "{\"parameter\": \"bruteForceSearchMaxBoundary\", \"boundary\": " << boundary
+                  << ", \"tree_s\": " << tree << ", \"brute_force_s\": " << brute << "}" << std::endl;
+        if (brute <= tree) crossover = boundary;
+    }
+
+    parameters.bruteForceSearchMaxBoundary = crossover;
+    std::cout << "{\"parameter\": \"bruteForceSearchMaxBoundary\", \"tuned\": " << crossover << "}" << std::endl;
+}
+
+// Narrowest box from which fillApproximate is faster in a tiled copy than in the image, on images of
+// growing width with the same disc of holes
+void tuneBlockedLayout() {
+    constexpr int32_t height = 2048;
+    holefill::Tuning& parameters = holefill::tuning();
+    size_t minWidth = std::numeric_limits<int32_t>::max();
+
+    for (const int32_t width : {16384, 8192, 4096, 2048}) {
+        const std::vector<float> workload = makeWorkload(width, height, 1000, 1000);
+        const auto fillFunc = [&](float* image) { holefill::fillApproximate(image, width, height); };
+
+        parameters.blockedLayoutMinWidth = std::numeric_limits<int32_t>::max();
+        const double rowMajor = timeFill(workload, 3, fillFunc);
+        parameters.blockedLayoutMinWidth = 0;
+        const double blocked = timeFill(workload, 3, fillFunc);
+
+        std::cout << "{\"parameter\": \"blockedLayoutMinWidth\", \"width\": " << width
+                  << ", \"row_major_s\": " << rowMajor << ", \"blocked_s\": " << blocked << "}" << std::endl;
+        if (blocked > rowMajor * (1.0 - requiredGain)) break;
+        minWidth = static_cast<size_t>(width);
+    }
+
+    parameters.blockedLayoutMinWidth = minWidth;
+    std::cout << "{\"parameter\": \"blockedLayoutMinWidth\", \"tuned\": " << minWidth << "}" << std::endl;
+}
+
+// Fits the cost model of planFill to the time of every engine on workloads it is linear in
+void tuneCostModel() {
+    holefill::Tuning& model = holefill::tuning();
+
+    // Seconds per unit of an engine over a workload, net of the scan every engine starts with
+    const auto perUnit = [&](const std::vector<float>& workload, const int32_t size, const auto& fillFunc,
+                             const auto& units) {
+        const holefill::FillPlan shape = holefill::planFill(workload.data(), size, size, defaultWeightFunction);
+        const double seconds = timeFill(workload, 3, fillFunc);
+        const double scan = model.scanSecondsPerPixel * static_cast<double>(size) * size;
+        return std::max(0.0, seconds - scan) / units(static_cast<double>(shape.holePixels),
+                                                     static_cast<double>(shape.boundaryPixels));
+    };
+    const auto neighbors = [](const double k) {
+        return [k](const double holes, const double boundary) { return holes * k * std::log2(boundary + 2.0); };
+    };
+
+    constexpr int32_t large = 1024;
+    constexpr int32_t small = 256;
+    const std::vector<float> dense = makeWorkload(large, large, 300, 40);
+    const std::vector<float> ring = makeWorkload(small, small, 100, 4);
+    std::vector<float> speck(static_cast<size_t>(large) * large, 0.5f);
+    speck[speck.size() / 2] = -1.0f;
+
+    model.scanSecondsPerPixel = timeFill(speck, 5, [&](float* image) {
+        holefill::fillApproximate(image, large, large);
+    }) / (static_cast<double>(large) * large);
+    model.exactSecondsPerPair = perUnit(ring, small, [&](float* image) {
+        holefill::fill(image, small, small, defaultWeightFunction);
+    }, [](const double holes, const double boundary) { return holes * boundary; });
+    model.approximateSecondsPerHole = perUnit(dense, large, [&](float* image) {
+        holefill::fillApproximate(image, large, large);
+    }, [](const double holes, double) { return holes; });
+    model.searchSecondsPerNeighbor = 0.5 * (
+        perUnit(dense, large, [&](float* image) {
+            holefill::fillExactWithSearch(image, large, large, defaultWeightFunction, 16);
+        }, neighbors(16)) +
+        perUnit(dense, large, [&](float* image) {
+            holefill::fillExactWithSearch(image, large, large, defaultWeightFunction, 64);
+        }, neighbors(64)));
+    model.dualTreeSecondsPerNeighbor = 0.5 * (
+        perUnit(dense, large, [&](float* image) {
+            holefill::fillExactWithDualTreeSearch(image, large, large, defaultWeightFunction, 16);
+        }, neighbors(16)) +
+        perUnit(dense, large, [&](float* image) {
+            holefill::fillExactWithDualTreeSearch(image, large, large, defaultWeightFunction, 64);
+        }, neighbors(64)));
+    model.stochasticSecondsPerSample = perUnit(dense, large, [&](float* image) {
+        holefill::fillStochastic(image, large, large, defaultWeightFunction, 64);
+    }, [](const double holes, double) { return holes * 64.0; });
+
+    std::cout << "{\"parameter\": \"cost_model\""
+              << ", \"scanSecondsPerPixel\": " << model.scanSecondsPerPixel
+              << ", \"exactSecondsPerPair\": " << model.exactSecondsPerPair
+              << ", \"approximateSecondsPerHole\": " << model.approximateSecondsPerHole
+              << ", \"searchSecondsPerNeighbor\": " << model.searchSecondsPerNeighbor
+              << ", \"dualTreeSecondsPerNeighbor\": " << model.dualTreeSecondsPerNeighbor
+              << ", \"stochasticSecondsPerSample\": " << model.stochasticSecondsPerSample << "}" << std::endl;
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [-o <tuning file>]" << std::endl;
+    std::cerr << "Measures the tuning parameters of the fill engines on this machine and saves them to the" << std::endl;
+    std::cerr << "given file, by default the file the library reads at startup: " << holefill::defaultTuningPath() << std::endl;
+}
+
+} // namespace
+
+int main(const int argc, const char** const argv) {
+    std::string path = holefill::defaultTuningPath();
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            path = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "No tuning file given and no configuration directory known" << std::endl;
+        return 1;
+    }
+
+    // Start from the defaults, not from a file tuned before
+    holefill::tuning() = holefill::Tuning{};
+
+    constexpr int32_t size = 1024;
+    const std::vector<float> ring = makeWorkload(size, size, 300, 40);
+
+    holefill::tuning().bruteForceSearchMaxBoundary = 0;
+    tuneLeafSize("searchLeafSize", &holefill::Tuning::searchLeafSize, ring, [&](float* image) {
+        holefill::fillExactWithSearch(image, size, size, defaultWeightFunction, 16);
+    });
+    tuneLeafSize("dualTreeLeafSize", &holefill::Tuning::dualTreeLeafSize, ring, [&](float* image) {
+        holefill::fillExactWithDualTreeSearch(image, size, size, defaultWeightFunction, 16);
+    });
+    constexpr int32_t small = 512;
+    const std::vector<float> smallRing = makeWorkload(small, small, 150, 20);
+    tuneLeafSize("floatTreeLeafSize", &holefill::Tuning::floatTreeLeafSize, smallRing, [&](float* image) {
+        holefill::fillAdaptive(image, small, small, defaultWeightFunction);
+    });
+    tuneSearchCrossover();
+    tuneBlockedLayout();
+    tuneCostModel();
+
+    const std::filesystem::path file(path);
+    std::error_code error;
+    if (file.has_parent_path()) std::filesystem::create_directories(file.parent_path(), error);
+    if (!holefill::saveTuning(path.c_str(), holefill::tuning())) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return 1;
+    }
+    std::cout << "Tuning written to " << path << std::endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "holefill.h"
+
+namespace holefill {
+
+// Tuning parameters by name, with the range of values loadTuning accepts
+struct CountParameter {
+    const char* name;
+    size_t Tuning::*field;
+    size_t min;
+    size_t max;
+};
+
+struct SecondsParameter {
+    const char* name;
+    double Tuning::*field;
+};
+
+constexpr CountParameter countParameters[] = {
+    {"bruteForceSearchMaxBoundary", &Tuning::bruteForceSearchMaxBoundary, 0, size_t{1} << 40},
+    {"searchLeafSize", &Tuning::searchLeafSize, 1, 4096},
+    {"dualTreeLeafSize", &Tuning::dualTreeLeafSize, 1, 4096},
+    {"floatTreeLeafSize", &Tuning::floatTreeLeafSize, 1, 4096},
+    {"blockedLayoutMinWidth", &Tuning::blockedLayoutMinWidth, 0, std::numeric_limits<int32_t>::max()},
+};
+
+// Any positive time is accepted; the planner only compares them
+constexpr SecondsParameter secondsParameters[] = {
+    {"scanSecondsPerPixel", &Tuning::scanSecondsPerPixel},
+    {"exactSecondsPerPair", &Tuning::exactSecondsPerPair},
+    {"approximateSecondsPerHole", &Tuning::approximateSecondsPerHole},
+    {"searchSecondsPerNeighbor", &Tuning::searchSecondsPerNeighbor},
+    {"dualTreeSecondsPerNeighbor", &Tuning::dualTreeSecondsPerNeighbor},
+    {"stochasticSecondsPerSample", &Tuning::stochasticSecondsPerSample},
+};
+
+Tuning& tuning() {
+    static Tuning parameters = [] {
+        Tuning loaded;
+        const std::string path = defaultTuningPath();
+        if (!path.empty()) loadTuning(path.c_str(), loaded);
+        return loaded;
+    }();
+    return parameters;
+}
+
+bool loadTuning(const char* const path, Tuning& tuning) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t separator = line.find('=');
+        if (line.empty() || line[0] == '#' || separator == std::string::npos) continue;
+
+        std::string name;
+        std::istringstream(line.substr(0, separator)) >> name;
+        std::istringstream valueStream(line.substr(separator + 1));
+
+        for (const CountParameter& parameter : countParameters) {
+            unsigned long long value;
+            if (name == parameter.name && valueStream >> value && value >= parameter.min && value <= parameter.max) {
+                tuning.*parameter.field = static_cast<size_t>(value);
+            }
+        }
+        for (const SecondsParameter& parameter : secondsParameters) {
+            double value;
+            if (name == parameter.name && valueStream >> value && std::isfinite(value) && value > 0.0) {
+                tuning.*parameter.field = value;
+            }
+        }
+    }
+    return true;
+}
+
+bool saveTuning(const char* const path, const Tuning& tuning) {
+    std::FILE* const file = std::fopen(path, "w");
+    if (!file) return false;
+
+    std::fprintf(file, "# holefill tuning parameters, read by holefill::loadTuning\n");
+    for (const CountParameter& parameter : countParameters) {
+        std::fprintf(file, "%s = %llu\n", parameter.name, static_cast<unsigned long long>(tuning.*parameter.field));
+    }
+    for (const SecondsParameter& parameter : secondsParameters) {
+        std::fprintf(file, "%s = %.6g\n", parameter.name, tuning.*parameter.field);
+    }
+    return std::fclose(file) == 0;
+}
+
+std::string defaultTuningPath() {
+    if (const char* const path = std::getenv("HOLEFILL_TUNING")) return path;
+#ifdef _WIN32
+    if (const char* const appData = std::getenv("APPDATA")) return std::string(appData) + "\\holefill\\tuning.conf";
+#else
+    if (const char* const config = std::getenv("XDG_CONFIG_HOME"); config && *config) {
+        return std::string(config) + "/holefill/tuning.conf";
+    }
+    if (const char* const home = std::getenv("HOME")) return std::string(home) + "/.config/holefill/tuning.conf";
+#endif
+    return "";
+}
+
+} // namespace holefill